@@ -2,61 +2,512 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <ctime>
-#include <cstdlib>
-
-// Transaction structure
-struct Transaction {
-    std::string transactionID;
-    int senderAccountID;
-    int receiverAccountID;
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Synthetic transaction workload generator.
+//
+// Rows are produced in fixed-size blocks. Every block draws from its own
+// generator seeded from (seed, block index) and covers its own slice of time,
+// so the output depends only on the options and never on the thread count.
+// Worker threads fill blocks in parallel and the main thread writes them in
+// order, keeping only a few blocks in memory however many rows are requested.
+
+// Generator settings, filled from the command line
+struct GeneratorOptions {
+    uint64_t rows = 200;
+    std::string output = "initial_transactions.txt";
+    std::string format = "csv";        // csv or binary
+    std::string labels;                // Ground-truth file; empty to skip
+    uint64_t seed = 42;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    int firstAccount = 100;
+    int accounts = 100;
+    double zipfExponent = 1.1;         // 0 for uniform account activity
+    long long startTime = 1730211227;
+    double meanGap = 1.0;              // Mean seconds between transactions
+    double burstRate = 0.01;           // Chance per row that a burst starts
+    double fraudRate = 0.01;           // Share of rows belonging to injected fraud
+};
+
+// Ground truth of a generated row
+enum class Scenario : uint8_t {
+    Normal,
+    Velocity,   // Rapid run of transfers from one account
+    Cycle,      // Money sent around a ring of accounts
+    Frequent,   // Repeated large transfers to the same account
+    Typo,       // Typo-squatted merchant name
+    Pattern     // Description ending in a suspicious keyword
+};
+
+const char* scenarioName(Scenario scenario) {
+    switch (scenario) {
+        case Scenario::Normal: return "normal";
+        case Scenario::Velocity: return "velocity";
+        case Scenario::Cycle: return "cycle";
+        case Scenario::Frequent: return "frequent";
+        case Scenario::Typo: return "typo";
+        case Scenario::Pattern: return "pattern";
+    }
+    return "unknown";
+}
+
+const std::vector<std::string> NORMAL_DESCRIPTIONS = {
+    "Groceries", "Salary", "Rent payment", "Utility bill", "Insurance premium",
+    "Mortgage payment", "Subscription fee", "Refund", "Invoice payment", "Deposit",
+    "Transfer", "Restaurant", "Fuel", "Pharmacy", "Tuition", "Gym membership"
+};
+const std::vector<std::string> BRAND_NAMES = { "Amazon", "Ebay", "Google", "Microsoft", "Facebook", "Paypal" };
+const std::vector<std::string> SUSPICIOUS_KEYWORDS = { "SALE", "DISCOUNT", "FREE", "OFFER", "PRIZE", "WINNER" };
+const std::vector<std::string> KEYWORD_LEADS = { "Limited", "Exclusive", "Claim your", "Today only", "Special" };
+
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Zipf-distributed ranks in [1, n] by rejection-inversion (Hörmann and
+// Derflinger), which needs O(1) memory and a couple of logs per draw however
+// large n is
+class ZipfDistribution {
+private:
+    double exponent;
+    uint64_t n;
+    double hIntegralX1, hIntegralN, s;
+
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+    }
+
+    double h(double x) const {
+        return std::exp(-exponent * std::log(x));
+    }
+
+    double hIntegral(double x) const {
+        double logX = std::log(x);
+        return helper2((1 - exponent) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const {
+        double t = std::max(-1.0, x * (1 - exponent));
+        return std::exp(helper1(t) * x);
+    }
+
+public:
+    ZipfDistribution(uint64_t n, double exponent) : exponent(exponent), n(n) {
+        hIntegralX1 = hIntegral(1.5) - 1;
+        hIntegralN = hIntegral(n + 0.5);
+        s = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+    }
+
+    template <typename Rng>
+    uint64_t operator()(Rng& rng) {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true) {
+            double u = hIntegralN + uniform(rng) * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            uint64_t k = static_cast<uint64_t>(std::clamp(x + 0.5, 1.0, static_cast<double>(n)));
+            if (k - x <= s || u >= hIntegral(k + 0.5) - h(static_cast<double>(k))) return k;
+        }
+    }
+};
+
+// Picks accounts with Zipf-skewed activity. Ranks are scattered over the
+// account range by a multiplicative permutation, so the busiest accounts are
+// not simply the lowest IDs.
+class AccountPicker {
+private:
+    int firstAccount;
+    uint64_t count;
+    double exponent;
+    ZipfDistribution zipf;
+    uint64_t multiplier, offset;
+
+public:
+    AccountPicker(int firstAccount, int accounts, double exponent, uint64_t salt)
+        : firstAccount(firstAccount), count(static_cast<uint64_t>(accounts)), exponent(exponent),
+          zipf(count, exponent > 0 ? exponent : 1.0) {
+        multiplier = (splitMix64(salt) % count) | 1;
+        while (std::gcd(multiplier, count) != 1) multiplier += 2;
+        offset = splitMix64(salt + 1) % count;
+    }
+
+    template <typename Rng>
+    int operator()(Rng& rng) {
+        uint64_t rank = exponent > 0 ? zipf(rng) - 1 : rng() % count;
+        return firstAccount + static_cast<int>((rank * multiplier + offset) % count);
+    }
+
+    template <typename Rng>
+    int uniform(Rng& rng) {
+        return firstAccount + static_cast<int>(rng() % count);
+    }
+};
+
+// One generated row; time is seconds from the start of its block
+struct Row {
+    int sender;
+    int receiver;
     double amount;
-    long long timestamp;
+    double time;
     std::string description;
+    Scenario scenario;
 };
 
-// Function to generate the transaction records file
-void generateTransactionFile(const std::string& filename, int numberOfTransactions) {
-    std::ofstream outfile(filename);
-    if (!outfile.is_open()) {
-        std::cerr << "Error opening file for writing." << std::endl;
-        return;
+// Serialized output of one block
+struct Block {
+    std::string data;
+    std::string labels;
+};
+
+class WorkloadGenerator {
+private:
+    static constexpr uint64_t ROWS_PER_BLOCK = 1 << 16;
+
+    const GeneratorOptions& options;
+    AccountPicker senderPicker, receiverPicker;
+    int idWidth;
+    double blockSpan;  // Seconds of timeline reserved for each block
+
+    template <typename Rng>
+    double amount(Rng& rng) {
+        // Log-normal amounts: mostly tens to low thousands, with a long tail
+        std::lognormal_distribution<double> distribution(5.5, 1.2);
+        return std::round(std::min(distribution(rng), 1e6) * 100) / 100;
     }
 
-    srand(time(0)); // Seed random number generator
+    template <typename Rng>
+    int otherAccount(Rng& rng, int sender) {
+        if (options.accounts < 2) return sender;
+        int receiver = receiverPicker(rng);
+        while (receiver == sender) receiver = receiverPicker.uniform(rng);
+        return receiver;
+    }
 
-    // Generate transactions
-    for (int i = 0; i < numberOfTransactions; ++i) {
-        int sender = 100 + rand() % 100; // Random sender ID between 100 and 119
-        int receiver = 100 + rand() % 100; // Random receiver ID between 100 and 119
-        while (receiver == sender) {
-            receiver = 100 + rand() % 100; // Ensure sender and receiver are different
+    template <typename Rng>
+    std::string typoOf(Rng& rng, const std::string& word) {
+        const char lookalikes[][2] = { { 'o', '0' }, { 'l', '1' }, { 'e', '3' }, { 's', '$' }, { 'a', '4' }, { 'i', '1' } };
+        std::string typo = word;
+        for (int edits = 1 + rng() % 2; edits > 0; --edits) {
+            size_t position = rng() % typo.size();
+            char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(typo[position])));
+            char replacement = 0;
+            for (const auto& pair : lookalikes) {
+                if (pair[0] == lower) replacement = pair[1];
+            }
+            if (replacement && rng() % 2 == 0) {
+                typo[position] = replacement;
+            } else if (rng() % 2 == 0) {
+                typo.insert(position, 1, typo[position]);  // Doubled letter
+            } else {
+                typo[position] = static_cast<char>('a' + rng() % 26);
+            }
         }
+        return typo;
+    }
 
-        double amount = (rand() % 1000) + 100; // Amount between 100 and 1100
-        std::string transactionID = std::to_string(i + 1);
-        while (transactionID.length() < 6) transactionID = "0" + transactionID; // Pad transaction ID
-
-        std::vector<std::string> descriptions = {
-            "Amazon purchase", "Groceries", "Electronics", "Salary", "Rent payment",
-            "Utility bill", "Insurance premium", "Mortgage payment", "Subscription fee",
-            "Refund", "Invoice payment", "Deposit", "Withdrawal", "Transfer", "SALE offer",
-            "DISCOUNT deal", "FREE gift", "OFFER limited", "PRIZE winner", "WINNER announcement",
-            "Amaz0n", "Ebayy", "G00gle", "Micro$oft", "Faceb00k"
+    // Appends a scenario's rows, all sharing the current time slot
+    template <typename Rng>
+    void injectScenario(Rng& rng, Scenario scenario, double& clock, std::vector<Row>& rows) {
+        auto add = [&](int sender, int receiver, double value, std::string description) {
+            rows.push_back({ sender, receiver, value, clock, std::move(description), scenario });
         };
-        std::string description = descriptions[rand() % descriptions.size()];
+        switch (scenario) {
+            case Scenario::Velocity: {
+                int sender = senderPicker.uniform(rng);
+                for (int i = 6 + rng() % 4; i > 0; --i) {
+                    add(sender, otherAccount(rng, sender), amount(rng), NORMAL_DESCRIPTIONS[rng() % NORMAL_DESCRIPTIONS.size()]);
+                    clock += rng() % 5;
+                }
+                break;
+            }
+            case Scenario::Cycle: {
+                int length = std::min(3 + static_cast<int>(rng() % 4), options.accounts);
+                std::vector<int> ring;
+                while (static_cast<int>(ring.size()) < length) {
+                    int account = senderPicker.uniform(rng);
+                    if (std::find(ring.begin(), ring.end(), account) == ring.end()) ring.push_back(account);
+                }
+                double value = amount(rng);
+                for (int i = 0; i < length; ++i) {
+                    add(ring[i], ring[(i + 1) % length], value, "Transfer");
+                    clock += 30 + rng() % 600;
+                    value = std::round(value * 0.97 * 100) / 100;  // Each hop keeps a cut
+                }
+                break;
+            }
+            case Scenario::Frequent: {
+                int sender = senderPicker.uniform(rng);
+                int receiver = otherAccount(rng, sender);
+                for (int i = 4 + rng() % 3; i > 0; --i) {
+                    add(sender, receiver, 15000 + rng() % 15000, "Invoice payment");
+                    clock += 60 + rng() % 3600;
+                }
+                break;
+            }
+            case Scenario::Typo: {
+                int sender = senderPicker(rng);
+                add(sender, otherAccount(rng, sender), amount(rng), typoOf(rng, BRAND_NAMES[rng() % BRAND_NAMES.size()]));
+                break;
+            }
+            case Scenario::Pattern: {
+                int sender = senderPicker(rng);
+                add(sender, otherAccount(rng, sender), amount(rng),
+                    KEYWORD_LEADS[rng() % KEYWORD_LEADS.size()] + " " + SUSPICIOUS_KEYWORDS[rng() % SUSPICIOUS_KEYWORDS.size()]);
+                break;
+            }
+            case Scenario::Normal:
+                break;
+        }
+    }
+
+    void formatRow(uint64_t rowNumber, long long rowTimestamp, const Row& row, Block& block) const {
+        char text[32];
+        std::string id = std::to_string(rowNumber);
+        if (static_cast<int>(id.size()) < idWidth) id.insert(0, idWidth - id.size(), '0');
+
+        if (options.format == "binary") {
+            auto put = [&](const void* bytes, size_t size) { block.data.append(static_cast<const char*>(bytes), size); };
+            int32_t sender = row.sender, receiver = row.receiver;
+            int64_t timestamp = rowTimestamp;
+            uint8_t idLength = static_cast<uint8_t>(id.size());
+            uint8_t descriptionLength = static_cast<uint8_t>(std::min<size_t>(row.description.size(), 255));
+            put(&idLength, 1);
+            put(id.data(), idLength);
+            put(&sender, 4);
+            put(&receiver, 4);
+            put(&row.amount, 8);
+            put(&timestamp, 8);
+            put(&descriptionLength, 1);
+            put(row.description.data(), descriptionLength);
+        } else {
+            block.data += id;
+            block.data += ',';
+            block.data += std::to_string(row.sender);
+            block.data += ',';
+            block.data += std::to_string(row.receiver);
+            block.data += ',';
+            block.data.append(text, std::to_chars(text, text + sizeof(text), row.amount).ptr);
+            block.data += ',';
+            block.data += std::to_string(rowTimestamp);
+            block.data += ',';
+            block.data += row.description;
+            block.data += '\n';
+        }
+        if (row.scenario != Scenario::Normal) {
+            block.labels += id;
+            block.labels += ',';
+            block.labels += scenarioName(row.scenario);
+            block.labels += '\n';
+        }
+    }
+
+public:
+    explicit WorkloadGenerator(const GeneratorOptions& options)
+        : options(options),
+          senderPicker(options.firstAccount, options.accounts, options.zipfExponent, options.seed),
+          receiverPicker(options.firstAccount, options.accounts, options.zipfExponent, options.seed + 1) {
+        idWidth = std::max<int>(6, static_cast<int>(std::to_string(options.rows).size()));
+        // Room for the expected gaps plus slack for bursts and injected runs;
+        // a block that still overruns is compressed into its slot
+        blockSpan = ROWS_PER_BLOCK * options.meanGap * 2;
+    }
 
-        // Write transaction to file
-        outfile << transactionID << "," << sender << "," << receiver << "," << amount 
-                << "," << (time(0) + i) << "," << description << "\n"; // Use current time + i for unique timestamps
+    uint64_t blockCount() const {
+        return (options.rows + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
     }
 
+    Block generateBlock(uint64_t blockIndex) {
+        std::mt19937_64 rng(splitMix64(options.seed ^ splitMix64(blockIndex + 1)));
+        uint64_t firstRow = blockIndex * ROWS_PER_BLOCK;
+        uint64_t rowCount = std::min(ROWS_PER_BLOCK, options.rows - firstRow);
+        std::exponential_distribution<double> gap(1.0 / options.meanGap);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        // Injected scenarios average about four rows
+        double scenarioChance = options.fraudRate / 4;
+
+        std::vector<Row> rows;
+        rows.reserve(rowCount + 16);
+        double clock = 0;
+        uint64_t burstRemaining = 0;
+        while (rows.size() < rowCount) {
+            if (uniform(rng) < scenarioChance && rowCount - rows.size() >= 10) {
+                Scenario scenario = static_cast<Scenario>(1 + rng() % 5);
+                injectScenario(rng, scenario, clock, rows);
+                continue;
+            }
+            if (burstRemaining == 0 && uniform(rng) < options.burstRate) burstRemaining = 20 + rng() % 200;
+            // Bursts arrive twenty times faster than the background traffic
+            clock += burstRemaining > 0 ? gap(rng) / 20 : gap(rng);
+            if (burstRemaining > 0) --burstRemaining;
+
+            int sender = senderPicker(rng);
+            rows.push_back({ sender, otherAccount(rng, sender), amount(rng), clock,
+                             NORMAL_DESCRIPTIONS[rng() % NORMAL_DESCRIPTIONS.size()], Scenario::Normal });
+        }
+        rows.resize(rowCount);
+
+        double scale = clock > blockSpan ? blockSpan / clock : 1.0;
+        double blockStart = static_cast<double>(options.startTime) + blockIndex * blockSpan;
+        Block block;
+        block.data.reserve(rowCount * 48);
+        for (uint64_t i = 0; i < rowCount; ++i) {
+            formatRow(firstRow + i + 1, static_cast<long long>(blockStart + rows[i].time * scale), rows[i], block);
+        }
+        return block;
+    }
+};
+
+// Generates every block on worker threads and writes them in order. Workers
+// stay at most a few blocks ahead of the writer to bound memory.
+bool generateTransactionFile(const GeneratorOptions& options) {
+    std::ofstream outfile(options.output, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening file for writing: " << options.output << std::endl;
+        return false;
+    }
+    std::ofstream labelFile;
+    if (!options.labels.empty()) {
+        labelFile.open(options.labels);
+        if (!labelFile.is_open()) {
+            std::cerr << "Error opening file for writing: " << options.labels << std::endl;
+            return false;
+        }
+        labelFile << "transactionID,scenario\n";
+    }
+    if (options.format == "binary") {
+        outfile.write("FDST\x01", 5);
+    }
+
+    WorkloadGenerator generator(options);
+    const uint64_t blocks = generator.blockCount();
+    const uint64_t window = 2 * options.threads;
+    std::vector<Block> slots(window);
+    std::vector<bool> ready(window, false);
+    std::atomic<uint64_t> nextBlock{0};
+    uint64_t written = 0;
+    std::mutex mutex;
+    std::condition_variable blockReady, slotFree;
+
+    auto worker = [&]() {
+        while (true) {
+            uint64_t index = nextBlock.fetch_add(1);
+            if (index >= blocks) return;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slotFree.wait(lock, [&]() { return index < written + window; });
+            }
+            Block block = generator.generateBlock(index);
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[index % window] = std::move(block);
+            ready[index % window] = true;
+            blockReady.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < options.threads; ++i) threads.emplace_back(worker);
+
+    while (written < blocks) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            blockReady.wait(lock, [&]() { return ready[written % window]; });
+            block = std::move(slots[written % window]);
+            ready[written % window] = false;
+        }
+        outfile.write(block.data.data(), static_cast<std::streamsize>(block.data.size()));
+        if (labelFile.is_open()) labelFile.write(block.labels.data(), static_cast<std::streamsize>(block.labels.size()));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++written;
+        }
+        slotFree.notify_all();
+    }
+    for (auto& thread : threads) thread.join();
+
     outfile.close();
-    std::cout << "Transaction file generated: " << filename << std::endl;
+    std::cout << "Transaction file generated: " << options.output << " (" << options.rows << " rows)" << std::endl;
+    return true;
 }
 
-// Usage example
-int main() {
-    generateTransactionFile("initial_transactions.txt", 200); // Generate 20 transactions
-    return 0;
+// Parse a whole numeric option value without allocating or throwing,
+// complaining on stderr if it is not one
+template <typename T>
+bool parseOptionNumber(const std::string& option, const std::string& text, T& value) {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    if (begin != end && *begin == '+') ++begin;
+    auto parsed = std::from_chars(begin, end, value);
+    if (parsed.ec == std::errc() && parsed.ptr == end && begin != end) return true;
+    std::cerr << "Invalid value for " << option << ": '" << text << "'" << std::endl;
+    return false;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--rows N] [--output file] [--format csv|binary] [--labels file]\n"
+              << "    [--seed N] [--threads N] [--first-account ID] [--accounts N] [--zipf exponent]\n"
+              << "    [--start-time epoch] [--mean-gap seconds] [--burst-rate p] [--fraud-rate f]\n"
+              << "Binary records follow a \"FDST\" + version byte header: ID length u8, ID bytes,\n"
+              << "sender i32, receiver i32, amount f64, timestamp i64, description length u8,\n"
+              << "description bytes. The labels file lists the injected fraud rows." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    GeneratorOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        bool valid = true;
+        if (arg == "--rows") valid = parseOptionNumber(arg, value, options.rows);
+        else if (arg == "--output") options.output = value;
+        else if (arg == "--format") options.format = value;
+        else if (arg == "--labels") options.labels = value;
+        else if (arg == "--seed") valid = parseOptionNumber(arg, value, options.seed);
+        else if (arg == "--threads") valid = parseOptionNumber(arg, value, options.threads);
+        else if (arg == "--first-account") valid = parseOptionNumber(arg, value, options.firstAccount);
+        else if (arg == "--accounts") valid = parseOptionNumber(arg, value, options.accounts);
+        else if (arg == "--zipf") valid = parseOptionNumber(arg, value, options.zipfExponent);
+        else if (arg == "--start-time") valid = parseOptionNumber(arg, value, options.startTime);
+        else if (arg == "--mean-gap") valid = parseOptionNumber(arg, value, options.meanGap);
+        else if (arg == "--burst-rate") valid = parseOptionNumber(arg, value, options.burstRate);
+        else if (arg == "--fraud-rate") valid = parseOptionNumber(arg, value, options.fraudRate);
+        else valid = false;
+        if (!valid) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // Account IDs run from firstAccount to firstAccount + accounts - 1 and must all be positive ints
+    if (options.threads < 1 || options.firstAccount < 1 || options.accounts < 1 ||
+        options.accounts - 1 > std::numeric_limits<int>::max() - options.firstAccount || !(options.meanGap > 0) ||
+        (options.format != "csv" && options.format != "binary")) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    return generateTransactionFile(options) ? 0 : 1;
 }
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -13,9 +14,40 @@
 #include <fstream>
 #include <utility>
 #include <limits> // For numeric_limits
-
-const int BLOOM_FILTER_SIZE = 10000;  // Increased size for larger dataset
-const int NUM_HASH_FUNCTIONS = 3;
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <type_traits>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 // Transaction structure
 struct Transaction {
@@ -27,522 +59,5797 @@ struct Transaction {
     std::string description;    // Transaction description
 };
 
-// Account structure
-struct Account {
-    int accountID;
-    double balance;
-    std::vector<Transaction> transactionHistory;
+// Transaction parsed in place: the text fields point into the loaded file buffer,
+// or into the Transaction it was made from. This is what the engines process.
+struct TransactionView {
+    std::string_view transactionID;
+    int senderAccountID;
+    int receiverAccountID;
+    double amount;
+    long long timestamp;
+    std::string_view description;
+
+    TransactionView() = default;
+
+    TransactionView(const Transaction& tx)
+        : transactionID(tx.transactionID), senderAccountID(tx.senderAccountID), receiverAccountID(tx.receiverAccountID),
+          amount(tx.amount), timestamp(tx.timestamp), description(tx.description) {}
+};
+
+// A transaction file line that could not be parsed
+struct ParseError {
+    size_t lineNumber;  // 1-based
+    std::string message;
 };
 
-// BK Tree Node
-class BKTreeNode {
+// SplitMix64 finalizer: a full-avalanche mix used by the hash tables and Bloom filter
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Serializes state into an in-memory snapshot image. Arrays of trivially
+// copyable elements are written as a count followed by their raw bytes, padded
+// to 8 bytes, so loading them back is a single copy with no parsing.
+class SnapshotWriter {
+private:
+    std::string buffer;
+
+    void pad() {
+        buffer.append((8 - buffer.size() % 8) % 8, '\0');
+    }
+
 public:
-    std::string word;
-    std::unordered_map<int, BKTreeNode*> children;
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        pad();
+    }
+
+    template <typename T>
+    void writeArray(const T* data, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be trivially copyable");
+        write<uint64_t>(count);
+        buffer.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+        pad();
+    }
+
+    template <typename T>
+    void writeVector(const std::vector<T>& values) {
+        writeArray(values.data(), values.size());
+    }
+
+    void writeString(const std::string& value) {
+        writeArray(value.data(), value.size());
+    }
+
+    std::string& image() {
+        return buffer;
+    }
+};
+
+// Reads a snapshot image written by SnapshotWriter, typically straight out of
+// a memory-mapped file. Any read past the end marks the reader as failed, and
+// every count is checked against the bytes left before anything is allocated.
+class SnapshotReader {
+private:
+    const char* cursor;
+    const char* end;
+    bool ok = true;
+
+    bool take(size_t bytes, const char*& data) {
+        size_t padded = bytes + (8 - bytes % 8) % 8;
+        if (!ok || static_cast<size_t>(end - cursor) < padded) {
+            ok = false;
+            return false;
+        }
+        data = cursor;
+        cursor += padded;
+        return true;
+    }
+
+public:
+    explicit SnapshotReader(std::string_view image) : cursor(image.data()), end(image.data() + image.size()) {}
+
+    template <typename T>
+    bool read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        const char* data;
+        if (!take(sizeof(T), data)) return false;
+        std::memcpy(&value, data, sizeof(T));
+        return true;
+    }
+
+    template <typename T>
+    bool readVector(std::vector<T>& values) {
+        uint64_t count;
+        const char* data;
+        if (!read(count) || count > static_cast<uint64_t>(end - cursor) / sizeof(T) || !take(count * sizeof(T), data)) {
+            ok = false;
+            return false;
+        }
+        values.resize(count);
+        if (count) std::memcpy(static_cast<void*>(values.data()), data, count * sizeof(T));
+        return true;
+    }
+
+    // Read the count of a section of count items, each at least minimumItemBytes
+    // long in the image (8 for strings: their own count)
+    bool readCount(uint64_t& count, size_t minimumItemBytes) {
+        if (!read(count) || count > static_cast<uint64_t>(end - cursor) / minimumItemBytes) {
+            ok = false;
+            return false;
+        }
+        return true;
+    }
+
+    bool readString(std::string& value) {
+        uint64_t count;
+        const char* data;
+        if (!read(count) || count > static_cast<uint64_t>(end - cursor) || !take(count, data)) {
+            ok = false;
+            return false;
+        }
+        value.assign(data, count);
+        return true;
+    }
+
+    bool good() const {
+        return ok;
+    }
+};
+
+// A file mapped read-only into memory (or read into a buffer where
+// mapping is unavailable). Views into contents() stay valid while it lives.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    bool opened = false;
+    std::string buffer;  // Fallback storage when the file cannot be mapped
+
+public:
+    explicit MappedFile(const std::string& filename) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat info;
+            if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+                opened = true;
+                length = static_cast<size_t>(info.st_size);
+                if (length > 0) {
+                    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (address != MAP_FAILED) {
+                        madvise(address, length, MADV_SEQUENTIAL);
+                        data = static_cast<const char*>(address);
+                        mapped = true;
+                    }
+                }
+            }
+            ::close(fd);
+            if (mapped || (opened && length == 0)) return;
+        }
+#endif
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) return;
+        opened = true;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        length = buffer.size();
+    }
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped) munmap(const_cast<char*>(data), length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const {
+        return opened;
+    }
+
+    std::string_view contents() const {
+        return std::string_view(data, length);
+    }
+};
+
+// Write data to path atomically: to path.tmp first, flushed to disk, then
+// renamed over path, so a crash leaves either the old file or the new one.
+bool writeFileDurably(const std::string& path, std::string_view data) {
+    std::string temporary = path + ".tmp";
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error opening file for writing: " << temporary << " (" << std::strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+    }
+    bool ok = written == data.size() && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (ok) ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+#else
+    bool ok;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        ok = file && file.write(data.data(), data.size()) && file.flush();
+    }
+    if (ok) ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok) {
+        std::cerr << "Error writing file: " << path << " (" << std::strerror(errno) << ")" << std::endl;
+        std::remove(temporary.c_str());
+    }
+    return ok;
+}
+
+// 64-bit checksum over 8-byte words, in four independent lanes so it runs at
+// memory speed on multi-gigabyte snapshots. Used by snapshots and the
+// write-ahead log.
+uint64_t checksum64(const char* data, size_t length) {
+    uint64_t lanes[4] = { 1, 2, 3, 4 };
+    size_t words = length / 8, i = 0;
+    for (; i + 4 <= words; i += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, data + (i + lane) * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * 0x9e3779b97f4a7c15ULL;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+    for (; i < words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, data + i * 8, 8);
+        lanes[0] = (lanes[0] ^ word) * 0x9e3779b97f4a7c15ULL;
+        lanes[0] ^= lanes[0] >> 29;
+    }
+    if (length % 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + words * 8, length % 8);
+        lanes[1] = (lanes[1] ^ word) * 0x9e3779b97f4a7c15ULL;
+    }
+    return mix64(lanes[0] ^ mix64(lanes[1] ^ mix64(lanes[2] ^ mix64(lanes[3] ^ length))));
+}
+
+// Snapshot file layout: this header, then the payload written by
+// FraudDetectionSystem::saveSnapshot. The layout fingerprint changes with the
+// byte order or the size of any record stored raw, so a snapshot is only ever
+// loaded by a build that lays memory out the same way.
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t layout;
+    uint64_t sequence;       // Transactions applied when the snapshot was taken
+    uint64_t payloadLength;  // Bytes after the header, a multiple of 8
+    uint64_t checksum;       // checksum64 of the payload
+};
+
+const char SNAPSHOT_MAGIC[4] = { 'F', 'D', 'S', 'S' };
+const uint32_t SNAPSHOT_VERSION = 3;
+
+// A state change recorded in the write-ahead log
+struct LogRecord {
+    enum class Type : uint8_t { Accepted = 1, Flag = 2 };
+    Type type;
+    uint64_t sequence;  // The transaction's position among all transactions applied
+    Transaction tx;     // Accepted: the whole transaction. Flag: sender, receiver and timestamp only
+    bool edgeKept;      // Flag: the rejected transfer's edge stays in the graph
+};
+
+// Append-only log of accepted transactions and account flags with group
+// commit. Records are encoded into an in-memory buffer that goes to disk as a
+// single write followed by one fdatasync, so durability costs one sequential
+// write per group rather than one synchronous write per transaction.
+// With a flush interval of zero, nothing is written until commit(), which the
+// caller runs once per batch and which returns once the batch is durable.
+// With a positive interval, a background thread commits whatever has
+// accumulated each interval and callers never wait; a crash loses at most
+// the last interval's records.
+// Each record is framed as [payload length][checksum][payload], so recovery
+// stops cleanly at a torn write.
+class WriteAheadLog {
+private:
+    int fd = -1;
+    std::chrono::milliseconds flushInterval{ 0 };
+    std::string pending;       // Encoded records not yet written
+    std::mutex mutex;          // Guards pending and stopping
+    std::condition_variable wake;
+    std::thread flusher;
+    bool stopping = false;
+    std::atomic<bool> failed{ false };
+    std::atomic<uint64_t> groupCount{ 0 };
+
+    template <typename T>
+    static void put(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void putString(std::string& out, std::string_view value) {
+        put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    template <typename T>
+    static bool get(std::string_view& in, T& value) {
+        if (in.size() < sizeof(T)) return false;
+        std::memcpy(&value, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    static bool getString(std::string_view& in, std::string& value) {
+        uint32_t length;
+        if (!get(in, length) || in.size() < length) return false;
+        value.assign(in.data(), length);
+        in.remove_prefix(length);
+        return true;
+    }
+
+    void appendRecord(const std::string& payload) {
+        std::lock_guard<std::mutex> lock(mutex);
+        put<uint32_t>(pending, static_cast<uint32_t>(payload.size()));
+        put<uint32_t>(pending, static_cast<uint32_t>(checksum64(payload.data(), payload.size())));
+        pending.append(payload);
+    }
+
+    // Write one group and make it durable
+    bool writeGroup(const std::string& group) {
+        if (group.empty()) return true;
+#if defined(__unix__) || defined(__APPLE__)
+        size_t written = 0;
+        while (written < group.size()) {
+            ssize_t n = ::write(fd, group.data() + written, group.size() - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            written += static_cast<size_t>(n);
+        }
+#if defined(__linux__)
+        bool ok = written == group.size() && ::fdatasync(fd) == 0;
+#else
+        bool ok = written == group.size() && ::fsync(fd) == 0;
+#endif
+        if (!ok && !failed.exchange(true)) {
+            std::cerr << "Error writing write-ahead log (" << std::strerror(errno) << ")" << std::endl;
+        }
+        ++groupCount;
+        return ok;
+#else
+        return false;
+#endif
+    }
+
+    void flushLoop() {
+        std::string group;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait_for(lock, flushInterval, [this] { return stopping; });
+            group.clear();
+            group.swap(pending);
+            bool done = stopping;
+            lock.unlock();
+            writeGroup(group);
+            lock.lock();
+            if (done && pending.empty()) return;
+        }
+    }
+
+public:
+    WriteAheadLog() = default;
+
+    ~WriteAheadLog() {
+        close();
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Open path for appending, first cutting it back to validLength (as
+    // reported by recover) so new records never follow a torn one
+    bool open(const std::string& path, uint64_t validLength, std::chrono::milliseconds interval) {
+#if defined(__unix__) || defined(__APPLE__)
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(validLength)) != 0 ||
+            ::lseek(fd, 0, SEEK_END) < 0) {
+            std::cerr << "Error opening write-ahead log: " << path << " (" << std::strerror(errno) << ")" << std::endl;
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+            return false;
+        }
+        flushInterval = interval;
+        if (flushInterval.count() > 0) {
+            flusher = std::thread([this] { flushLoop(); });
+        }
+        return true;
+#else
+        (void)path;
+        (void)validLength;
+        (void)interval;
+        std::cerr << "Write-ahead logging is not supported on this platform." << std::endl;
+        return false;
+#endif
+    }
+
+    // Commit what remains and close the file
+    void close() {
+        if (fd < 0) return;
+        if (flusher.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            flusher.join();
+        } else {
+            commit();
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+
+    // True when the caller commits each batch itself
+    bool commitsPerBatch() const {
+        return flushInterval.count() == 0;
+    }
+
+    // Make every record appended so far durable. Only for commitsPerBatch mode,
+    // where the appending thread is the only one touching the file.
+    bool commit() {
+        std::string group;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            group.swap(pending);
+        }
+        return writeGroup(group);
+    }
+
+    void appendAccepted(uint64_t sequence, const TransactionView& tx) {
+        std::string payload;
+        put(payload, LogRecord::Type::Accepted);
+        put(payload, sequence);
+        put<int32_t>(payload, tx.senderAccountID);
+        put<int32_t>(payload, tx.receiverAccountID);
+        put(payload, tx.amount);
+        put<int64_t>(payload, tx.timestamp);
+        putString(payload, tx.transactionID);
+        putString(payload, tx.description);
+        appendRecord(payload);
+    }
+
+    void appendFlag(uint64_t sequence, int accountID, int receiverID, long long timestamp, bool edgeKept) {
+        std::string payload;
+        put(payload, LogRecord::Type::Flag);
+        put(payload, sequence);
+        put<int32_t>(payload, accountID);
+        put<int32_t>(payload, receiverID);
+        put<int64_t>(payload, timestamp);
+        put<uint8_t>(payload, edgeKept);
+        appendRecord(payload);
+    }
+
+    uint64_t groupsCommitted() const {
+        return groupCount;
+    }
+
+    bool healthy() const {
+        return !failed;
+    }
+
+    // Read the log at path, calling apply for each intact record in order.
+    // Stops at the first torn or corrupt record; validLength is set to the
+    // bytes before it. A missing log reads as empty. Fails if apply rejects a
+    // record, which it must do before changing anything.
+    static bool recover(const std::string& path, const std::function<bool(const LogRecord&)>& apply, uint64_t& validLength) {
+        validLength = 0;
+        std::ifstream probe(path, std::ios::binary);
+        if (!probe) return true;
+        probe.close();
+        MappedFile file(path);
+        if (!file.isOpen()) {
+            std::cerr << "Error opening write-ahead log: " << path << std::endl;
+            return false;
+        }
+        std::string_view contents = file.contents();
+        LogRecord record;
+        while (true) {
+            std::string_view frame = contents.substr(validLength);
+            uint32_t length, checksum;
+            if (!get(frame, length) || !get(frame, checksum) || frame.size() < length ||
+                static_cast<uint32_t>(checksum64(frame.data(), length)) != checksum) {
+                break;
+            }
+            std::string_view payload = frame.substr(0, length);
+            int32_t sender = 0, receiver = 0;
+            bool ok = get(payload, record.type) && get(payload, record.sequence) && get(payload, sender) && get(payload, receiver);
+            record.tx.senderAccountID = sender;
+            record.tx.receiverAccountID = receiver;
+            if (ok && record.type == LogRecord::Type::Accepted) {
+                int64_t timestamp = 0;
+                ok = get(payload, record.tx.amount) && get(payload, timestamp) &&
+                     getString(payload, record.tx.transactionID) && getString(payload, record.tx.description);
+                record.tx.timestamp = timestamp;
+            } else if (ok && record.type == LogRecord::Type::Flag) {
+                int64_t timestamp = 0;
+                uint8_t edgeKept = 0;
+                ok = get(payload, timestamp) && get(payload, edgeKept);
+                record.tx.timestamp = timestamp;
+                record.edgeKept = edgeKept != 0;
+            } else {
+                ok = false;
+            }
+            if (!ok) break;
+            if (!apply(record)) {
+                std::cerr << "Write-ahead log " << path << ": cannot apply record " << record.sequence
+                          << " at byte " << validLength << "; recovery stopped." << std::endl;
+                return false;
+            }
+            validLength += 2 * sizeof(uint32_t) + length;
+        }
+        if (validLength < contents.size()) {
+            std::cerr << "Write-ahead log " << path << ": ignoring " << contents.size() - validLength
+                      << " bytes after the last intact record." << std::endl;
+        }
+        return true;
+    }
+};
+
+// ASCII lower-case n bytes from in to out, which may be the same buffer. Other
+// bytes are copied unchanged, as tolower does in the "C" locale the program
+// runs in. Folds 16 bytes per step with SSE2.
+inline void foldAsciiCase(const char* in, size_t n, char* out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Shift 'A'..'Z' to the 26 smallest signed bytes, so one compare finds them
+    const __m128i shift = _mm_set1_epi8(static_cast<char>(0x80 - 'A'));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(0x80 + 26));
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= n; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i upper = _mm_cmplt_epi8(_mm_add_epi8(chunk, shift), limit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(chunk, _mm_and_si128(upper, caseBit)));
+    }
+#endif
+    for (; i < n; ++i) {
+        char c = in[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+}
+
+// Splits text into whitespace-separated words the way operator>> does, as views
+// into text, without allocating
+class WordTokenizer {
+private:
+    std::string_view text;
+    size_t position = 0;
+
+    static bool isSpace(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+public:
+    explicit WordTokenizer(std::string_view text) : text(text) {}
 
-    BKTreeNode(const std::string& w) : word(w) {}
+    // The next word, or false at the end of the text
+    bool next(std::string_view& word) {
+        while (position < text.size() && isSpace(text[position])) ++position;
+        if (position == text.size()) return false;
+        size_t start = position;
+        while (position < text.size() && !isSpace(text[position])) ++position;
+        word = text.substr(start, position - start);
+        return true;
+    }
+};
+
+// Case-folded query word, prepared once and compared against many dictionary words.
+// Words of up to 64 characters use Myers/Hyyro bit-parallel edit distance; longer
+// words fall back to a banded dynamic program. Both stop as soon as the distance
+// is known to exceed the caller's bound, and neither allocates per comparison.
+class LevenshteinQuery {
+private:
+    std::string folded;
+    uint64_t peq[256];  // Bit i set when folded[i] == c (only used for words <= 64 chars)
+
+    int bitParallelDistance(std::string_view word, int bound) const {
+        const int m = static_cast<int>(folded.size());
+        const int n = static_cast<int>(word.size());
+        const uint64_t highBit = 1ULL << (m - 1);
+        uint64_t pv = ~0ULL, mv = 0;
+        int score = m;
+
+        for (int j = 0; j < n; ++j) {
+            uint64_t eq = peq[static_cast<unsigned char>(word[j])];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & highBit) {
+                ++score;
+            } else if (mh & highBit) {
+                --score;
+            }
+            // Each remaining character can lower the score by at most one
+            if (score - (n - j - 1) > bound) return bound + 1;
+            ph = (ph << 1) | 1;  // Row 0 of the DP grows by one per column
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+        return score;
+    }
+
+    int bandedDistance(std::string_view word, int bound) const {
+        const int m = static_cast<int>(folded.size());
+        const int n = static_cast<int>(word.size());
+        const int inf = bound + 1;
+
+        thread_local std::vector<int> rows;
+        if (rows.size() < 2 * static_cast<size_t>(n + 1)) rows.resize(2 * static_cast<size_t>(n + 1));
+        int* prev = rows.data();
+        int* cur = prev + n + 1;
+
+        for (int j = 0; j <= n; ++j) prev[j] = j <= bound ? j : inf;
+
+        for (int i = 1; i <= m; ++i) {
+            int lo = std::max(1, i - bound), hi = std::min(n, i + bound);
+            cur[lo - 1] = (lo == 1 && i <= bound) ? i : inf;
+            int rowMin = cur[lo - 1];
+            for (int j = lo; j <= hi; ++j) {
+                int cost = (folded[i - 1] == word[j - 1]) ? 0 : 1;
+                int v = std::min({ prev[j - 1] + cost, prev[j] + 1, cur[j - 1] + 1, inf });
+                cur[j] = v;
+                rowMin = std::min(rowMin, v);
+            }
+            if (hi < n) cur[hi + 1] = inf;
+            if (rowMin > bound) return inf;
+            std::swap(prev, cur);
+        }
+        return prev[n];
+    }
+
+public:
+    LevenshteinQuery() = default;
+
+    explicit LevenshteinQuery(std::string_view word) {
+        assign(word);
+    }
+
+    // Prepare for a new query word, reusing this query's storage
+    void assign(std::string_view word) {
+        folded.assign(word.data(), word.size());
+        foldAsciiCase(folded.data(), folded.size(), folded.data());
+        if (folded.size() <= 64) {
+            std::fill(std::begin(peq), std::end(peq), 0);
+            for (size_t i = 0; i < folded.size(); ++i) {
+                peq[static_cast<unsigned char>(folded[i])] |= 1ULL << i;
+            }
+        }
+    }
+
+    static std::string foldCase(std::string_view word) {
+        std::string result(word);
+        foldAsciiCase(result.data(), result.size(), result.data());
+        return result;
+    }
+
+    // Distance to an already case-folded word. Exact when it is <= bound,
+    // otherwise some value greater than bound.
+    int distance(std::string_view word, int bound) const {
+        const int m = static_cast<int>(folded.size());
+        const int n = static_cast<int>(word.size());
+        bound = std::min(bound, std::max(m, n));
+        if (std::abs(m - n) > bound) return bound + 1;
+        if (m == 0 || n == 0) return std::max(m, n);
+        return m <= 64 ? bitParallelDistance(word, bound) : bandedDistance(word, bound);
+    }
 };
 
-// BK Tree for typo detection
+// BK Tree for typo detection.
+// Nodes live in one array, each with a sorted span of (distance, child) edges in a
+// shared edge array, and all words are packed into a single string pool.
 class BKTree {
 private:
-    BKTreeNode* root;
+    struct Node {
+        uint32_t wordOffset;   // Case-folded word in wordPool
+        uint32_t wordLength;
+        uint32_t firstEdge;    // Children: edges[firstEdge, firstEdge + edgeCount), sorted by distance
+        uint32_t edgeCount;
+    };
+
+    struct Edge {
+        int distance;
+        uint32_t child;
+    };
+
+    std::vector<Node> nodes;   // nodes[0] is the root
+    std::vector<Edge> edges;
+    std::string wordPool;
+    size_t staleEdges = 0;     // Edge slots abandoned when a span was moved to grow
+    uint64_t revision = 0;     // Bumped whenever the dictionary changes
+
+    std::string_view wordAt(const Node& node) const {
+        return std::string_view(wordPool).substr(node.wordOffset, node.wordLength);
+    }
+
+public:
+    // A dictionary word close to a query word. The view into the tree is valid
+    // until the dictionary next changes.
+    struct Match {
+        std::string_view word;
+        int distance;
+    };
+
+    // Traversal state for searchBatch. Keep one per thread and reuse it, so
+    // searches stop allocating once it has grown.
+    class SearchScratch {
+    private:
+        friend class BKTree;
+        std::vector<LevenshteinQuery> queries;
+        std::vector<int> radius;                              // Per query: farthest match still wanted
+        std::vector<std::pair<uint32_t, uint64_t>> pending;   // Node, queries that may match in its subtree
+        std::vector<uint64_t> childQueries;                   // Per edge of the current node
+    };
+
+private:
+    // Add a match to a query's best-k list, kept sorted by distance with ties
+    // in the order found, and shrink its radius once the list is full
+    static void offerMatch(std::vector<Match>& best, const Match& match, size_t k, int& radius) {
+        auto pos = std::upper_bound(best.begin(), best.end(), match.distance,
+                                    [](int d, const Match& m) { return d < m.distance; });
+        best.insert(pos, match);
+        if (best.size() > k) best.pop_back();
+        if (best.size() == k) radius = best.back().distance - 1;
+    }
+
+    uint32_t addNode(const std::string& folded) {
+        nodes.push_back({ static_cast<uint32_t>(wordPool.size()), static_cast<uint32_t>(folded.size()), 0, 0 });
+        wordPool += folded;
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    // Insert (distance, child) into node's span, moving the span to the end of the
+    // edge array when it cannot grow in place
+    void addEdge(uint32_t nodeIndex, int distance, uint32_t child) {
+        Node& node = nodes[nodeIndex];
+        if (node.firstEdge + node.edgeCount != edges.size()) {
+            std::vector<Edge> span(edges.begin() + node.firstEdge, edges.begin() + node.firstEdge + node.edgeCount);
+            staleEdges += node.edgeCount;
+            node.firstEdge = static_cast<uint32_t>(edges.size());
+            edges.insert(edges.end(), span.begin(), span.end());
+        }
+        Edge* begin = edges.data() + node.firstEdge;
+        Edge* end = begin + node.edgeCount;
+        Edge* pos = std::upper_bound(begin, end, distance, [](int d, const Edge& e) { return d < e.distance; });
+        size_t offset = pos - edges.data();
+        edges.insert(edges.begin() + offset, { distance, child });
+        ++node.edgeCount;
+
+        if (staleEdges > edges.size() / 2) compact();
+    }
+
+public:
+    void insert(const std::string& word) {
+        ++revision;
+        LevenshteinQuery query(word);
+        std::string folded = LevenshteinQuery::foldCase(word);
+        if (nodes.empty()) {
+            addNode(folded);
+            return;
+        }
+
+        uint32_t current = 0;
+        while (true) {
+            int distance = query.distance(wordAt(nodes[current]), std::numeric_limits<int>::max());
+            const Edge* begin = edges.data() + nodes[current].firstEdge;
+            const Edge* end = begin + nodes[current].edgeCount;
+            const Edge* match = std::lower_bound(begin, end, distance, [](const Edge& e, int d) { return e.distance < d; });
+            if (match == end || match->distance != distance) {
+                uint32_t child = addNode(folded);
+                addEdge(current, distance, child);
+                return;
+            }
+            current = match->child;
+        }
+    }
+
+    // Re-lay the tree out in breadth-first order with gap-free edge spans, so a
+    // search walks memory front to back. Called after bulk loads.
+    void compact() {
+        if (nodes.empty()) return;
+        std::vector<Node> newNodes;
+        std::vector<Edge> newEdges;
+        std::string newPool;
+        newNodes.reserve(nodes.size());
+        newEdges.reserve(nodes.size() - 1);
+        newPool.reserve(wordPool.size());
+
+        std::vector<uint32_t> order(1, 0);  // Old indices in BFS order
+        for (size_t head = 0; head < order.size(); ++head) {
+            const Node& node = nodes[order[head]];
+            for (uint32_t e = 0; e < node.edgeCount; ++e) order.push_back(edges[node.firstEdge + e].child);
+        }
+        std::vector<uint32_t> newIndex(nodes.size());
+        for (size_t i = 0; i < order.size(); ++i) newIndex[order[i]] = static_cast<uint32_t>(i);
+
+        for (uint32_t oldIndex : order) {
+            const Node& node = nodes[oldIndex];
+            newNodes.push_back({ static_cast<uint32_t>(newPool.size()), node.wordLength,
+                                 static_cast<uint32_t>(newEdges.size()), node.edgeCount });
+            newPool.append(wordPool, node.wordOffset, node.wordLength);
+            for (uint32_t e = 0; e < node.edgeCount; ++e) {
+                const Edge& edge = edges[node.firstEdge + e];
+                newEdges.push_back({ edge.distance, newIndex[edge.child] });
+            }
+        }
+
+        nodes.swap(newNodes);
+        edges.swap(newEdges);
+        wordPool.swap(newPool);
+        staleEdges = 0;
+    }
+
+    uint64_t version() const {
+        return revision;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.writeVector(nodes);
+        out.writeVector(edges);
+        out.writeString(wordPool);
+        out.write<uint64_t>(staleEdges);
+    }
+
+    bool load(SnapshotReader& in) {
+        uint64_t stale = 0;
+        bool ok = in.readVector(nodes) && in.readVector(edges) && in.readString(wordPool) && in.read(stale);
+        staleEdges = stale;
+        ++revision;
+        // Every word and child range must lie inside the loaded arrays
+        for (size_t i = 0; ok && i < nodes.size(); ++i) {
+            const Node& node = nodes[i];
+            ok = static_cast<uint64_t>(node.wordOffset) + node.wordLength <= wordPool.size() &&
+                 static_cast<uint64_t>(node.firstEdge) + node.edgeCount <= edges.size();
+        }
+        for (size_t i = 0; ok && i < edges.size(); ++i) ok = edges[i].child < nodes.size();
+        return ok;
+    }
+
+    // Whether any word is within maxDistance of word (exact matches excluded);
+    // stops at the first one found
+    bool search(std::string_view word, int maxDistance) const {
+        if (nodes.empty()) return false;
+
+        LevenshteinQuery query(word);
+        thread_local std::vector<uint32_t> pending;
+        pending.assign(1, 0);
+
+        for (size_t head = 0; head < pending.size(); ++head) {
+            const Node& node = nodes[pending[head]];
+            const Edge* begin = edges.data() + node.firstEdge;
+            const Edge* end = begin + node.edgeCount;
+
+            // Beyond this bound neither the node nor any of its children can qualify
+            int bound = (node.edgeCount ? end[-1].distance : 0) + maxDistance;
+            int distance = query.distance(wordAt(node), bound);
+            if (distance <= maxDistance && distance > 0) {  // distance > 0 to exclude exact matches
+                return true;
+            }
+            if (distance > bound) continue;
+
+            for (const Edge* edge = begin; edge != end && edge->distance <= distance + maxDistance; ++edge) {
+                if (edge->distance >= distance - maxDistance) {
+                    pending.push_back(edge->child);
+                }
+            }
+        }
+        return false;
+    }
+
+    // The k closest words to each of count query words, at distances 1 to
+    // maxDistance (exact matches excluded), closest first; equally close words
+    // come in tree order. results[i] receives the matches for words[i]. Up to
+    // 64 queries walk the tree together, so each node is fetched once for every
+    // query that can still match below it, and a query's search narrows as its
+    // best k improve.
+    void searchBatch(const std::string_view* words, size_t count, int maxDistance, size_t k,
+                     SearchScratch& scratch, std::vector<std::vector<Match>>& results) const {
+        if (results.size() < count) results.resize(count);
+        for (size_t i = 0; i < count; ++i) results[i].clear();
+        if (nodes.empty() || k == 0) return;
+
+        for (size_t first = 0; first < count; first += 64) {
+            size_t batch = std::min<size_t>(64, count - first);
+            if (scratch.queries.size() < batch) scratch.queries.resize(batch);
+            for (size_t q = 0; q < batch; ++q) scratch.queries[q].assign(words[first + q]);
+            scratch.radius.assign(batch, maxDistance);
+            scratch.pending.assign(1, { 0u, batch == 64 ? ~0ULL : (1ULL << batch) - 1 });
+
+            for (size_t head = 0; head < scratch.pending.size(); ++head) {
+                const Node& node = nodes[scratch.pending[head].first];
+                uint64_t interested = scratch.pending[head].second;
+                const Edge* begin = edges.data() + node.firstEdge;
+                const Edge* end = begin + node.edgeCount;
+                int farthestChild = node.edgeCount ? end[-1].distance : 0;
+                std::string_view word = wordAt(node);
+                scratch.childQueries.assign(node.edgeCount, 0);
+                bool descend = false;
+
+                for (; interested; interested &= interested - 1) {
+                    int q = __builtin_ctzll(interested);
+                    int& radius = scratch.radius[q];
+                    if (radius <= 0) continue;  // Already holds k matches at distance 1
+
+                    // Beyond this bound neither the node nor any of its children can qualify
+                    int bound = farthestChild + radius;
+                    int distance = scratch.queries[q].distance(word, bound);
+                    if (distance <= radius && distance > 0) {
+                        offerMatch(results[first + q], { word, distance }, k, radius);
+                    }
+                    if (distance > bound) continue;
+
+                    for (const Edge* edge = begin; edge != end && edge->distance <= distance + radius; ++edge) {
+                        if (edge->distance >= distance - radius) {
+                            scratch.childQueries[edge - begin] |= 1ULL << q;
+                            descend = true;
+                        }
+                    }
+                }
+                if (!descend) continue;
+                for (uint32_t e = 0; e < node.edgeCount; ++e) {
+                    if (scratch.childQueries[e]) scratch.pending.push_back({ begin[e].child, scratch.childQueries[e] });
+                }
+            }
+        }
+    }
+};
 
-    int levenshteinDistance(const std::string& s1, const std::string& s2) {
-        int len1 = s1.size(), len2 = s2.size();
-        std::vector<std::vector<int>> d(len1 + 1, std::vector<int>(len2 + 1));
+// Aho-Corasick automaton for suspicious pattern detection.
+// The pattern set is compiled once into a flat DFA (states x character classes),
+// so each description is matched in a single pass with no allocation, whatever
+// the number of patterns.
+class PatternAutomaton {
+private:
+    std::vector<std::string> patterns;     // Original spelling, used in alerts
+    std::vector<int> transitions;          // numStates * numClasses goto table
+    std::vector<int> output;               // Longest pattern ending at state, -1 if none
+    unsigned char charClass[256];          // Case-folded byte -> column; 0 = not in any pattern
+    int numClasses;
+    uint64_t revision = 0;                 // Bumped on every build
+
+public:
+    PatternAutomaton() {
+        build({});
+    }
+
+    void build(const std::unordered_set<std::string>& patternSet) {
+        ++revision;
+        patterns.assign(patternSet.begin(), patternSet.end());
+
+        // Assign one column per distinct (case-folded) byte used by the patterns
+        std::fill(std::begin(charClass), std::end(charClass), 0);
+        numClasses = 1;
+        for (const auto& pattern : patterns) {
+            for (char ch : pattern) {
+                unsigned char c = static_cast<unsigned char>(tolower(static_cast<unsigned char>(ch)));
+                if (charClass[c] == 0) {
+                    charClass[c] = static_cast<unsigned char>(numClasses++);
+                }
+            }
+        }
+        for (int c = 0; c < 256; ++c) {
+            charClass[c] = charClass[static_cast<unsigned char>(tolower(c))];
+        }
+
+        // Build the trie
+        transitions.assign(numClasses, -1);
+        output.assign(1, -1);
+        for (size_t p = 0; p < patterns.size(); ++p) {
+            int state = 0;
+            for (char ch : patterns[p]) {
+                int cls = charClass[static_cast<unsigned char>(ch)];
+                if (transitions[state * numClasses + cls] < 0) {
+                    transitions[state * numClasses + cls] = static_cast<int>(output.size());
+                    transitions.resize(transitions.size() + numClasses, -1);
+                    output.push_back(-1);
+                }
+                state = transitions[state * numClasses + cls];
+            }
+            if (output[state] < 0 || patterns[output[state]].size() < patterns[p].size()) {
+                output[state] = static_cast<int>(p);
+            }
+        }
+
+        // Breadth-first pass: resolve failure links into direct transitions
+        std::vector<int> fail(output.size(), 0);
+        std::queue<int> states;
+        for (int cls = 0; cls < numClasses; ++cls) {
+            int& next = transitions[cls];
+            if (next < 0) {
+                next = 0;
+            } else {
+                states.push(next);
+            }
+        }
+        while (!states.empty()) {
+            int state = states.front();
+            states.pop();
+            if (output[state] < 0) {
+                output[state] = output[fail[state]];
+            }
+            for (int cls = 0; cls < numClasses; ++cls) {
+                int& next = transitions[state * numClasses + cls];
+                int fallback = transitions[fail[state] * numClasses + cls];
+                if (next < 0) {
+                    next = fallback;
+                } else {
+                    fail[next] = fallback;
+                    states.push(next);
+                }
+            }
+        }
+    }
+
+    uint64_t version() const {
+        return revision;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.write<uint64_t>(patterns.size());
+        for (const auto& pattern : patterns) out.writeString(pattern);
+        out.writeVector(transitions);
+        out.writeVector(output);
+        out.writeArray(charClass, 256);
+        out.write(numClasses);
+    }
+
+    // Loads into temporaries and checks every table index before replacing
+    // the automaton, which is left as it was on failure
+    bool load(SnapshotReader& in) {
+        uint64_t count = 0;
+        if (!in.readCount(count, sizeof(uint64_t))) return false;
+        std::vector<std::string> loadedPatterns(count);
+        for (auto& pattern : loadedPatterns) {
+            if (!in.readString(pattern)) return false;
+        }
+        std::vector<int> loadedTransitions, loadedOutput;
+        std::vector<unsigned char> classes;
+        int loadedClasses = 0;
+        if (!in.readVector(loadedTransitions) || !in.readVector(loadedOutput) || !in.readVector(classes) ||
+            !in.read(loadedClasses)) {
+            return false;
+        }
+
+        size_t states = loadedOutput.size();
+        if (classes.size() != 256 || loadedClasses < 1 || loadedClasses > 256 || states == 0 ||
+            loadedTransitions.size() / loadedClasses != states || loadedTransitions.size() % loadedClasses != 0) {
+            return false;
+        }
+        for (unsigned char cls : classes) {
+            if (cls >= loadedClasses) return false;
+        }
+        for (int next : loadedTransitions) {
+            if (next < 0 || static_cast<size_t>(next) >= states) return false;
+        }
+        for (int pattern : loadedOutput) {
+            if (pattern < -1 || pattern >= static_cast<long long>(loadedPatterns.size())) return false;
+        }
+
+        patterns = std::move(loadedPatterns);
+        transitions = std::move(loadedTransitions);
+        output = std::move(loadedOutput);
+        std::copy(classes.begin(), classes.end(), charClass);
+        numClasses = loadedClasses;
+        ++revision;
+        return true;
+    }
+
+    // Returns the longest pattern the text ends with (case-insensitive), or nullptr
+    const std::string* matchSuffix(std::string_view text) const {
+        int state = 0;
+        for (char ch : text) {
+            state = transitions[state * numClasses + charClass[static_cast<unsigned char>(ch)]];
+        }
+        return output[state] < 0 ? nullptr : &patterns[output[state]];
+    }
+};
+
+// Bounded, thread-safe memo of verdicts keyed by string. Entries are spread over
+// mutex-protected shards, each evicting its oldest entry once full. The whole cache
+// is dropped when the dictionaries it was computed from change version.
+template <typename Value>
+class VerdictCache {
+private:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Value> entries;
+        std::vector<std::string> insertionOrder;  // Ring of keys, oldest at nextEviction
+        size_t nextEviction = 0;
+    };
+
+    Shard shards[NUM_SHARDS];
+    size_t shardCapacity;
+    std::atomic<uint64_t> dictionaryVersion{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+    Shard& shardFor(const std::string& key) {
+        return shards[std::hash<std::string>()(key) % NUM_SHARDS];
+    }
+
+public:
+    explicit VerdictCache(size_t capacity) : shardCapacity(std::max<size_t>(1, capacity / NUM_SHARDS)) {}
+
+    // Drop every entry if the dictionaries have changed since they were cached
+    void validate(uint64_t version) {
+        if (dictionaryVersion.load(std::memory_order_acquire) == version) return;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.insertionOrder.clear();
+            shard.nextEviction = 0;
+        }
+        dictionaryVersion.store(version, std::memory_order_release);
+    }
+
+    bool lookup(const std::string& key, Value& value) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        hits.fetch_add(1, std::memory_order_relaxed);
+        value = it->second;
+        return true;
+    }
+
+    void store(const std::string& key, const Value& value) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.entries.emplace(key, value).second) return;
+        if (shard.insertionOrder.size() < shardCapacity) {
+            shard.insertionOrder.push_back(key);
+            return;
+        }
+        std::string& oldest = shard.insertionOrder[shard.nextEviction];
+        shard.entries.erase(oldest);
+        oldest = key;
+        shard.nextEviction = (shard.nextEviction + 1) % shardCapacity;
+    }
+
+    uint64_t hitCount() const {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+    uint64_t missCount() const {
+        return misses.load(std::memory_order_relaxed);
+    }
+};
+
+// Latency histogram with log-linear buckets: values below 64 ns are exact,
+// larger ones fall into 32 sub-buckets per power of two (about 3% relative
+// error), so percentiles stay accurate over many orders of magnitude while
+// recording is a couple of shifts and an increment.
+class LatencyHistogram {
+private:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int LINEAR_LIMIT = 2 * SUB_BUCKETS;  // Values below are their own bucket
+    static const int NUM_BUCKETS = LINEAR_LIMIT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+    std::vector<uint64_t> buckets;
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+    uint64_t sum = 0;
+
+    static int bucketOf(uint64_t value) {
+        if (value < static_cast<uint64_t>(LINEAR_LIMIT)) return static_cast<int>(value);
+        int exponent = 63 - __builtin_clzll(value);  // >= SUB_BUCKET_BITS + 1
+        int shift = exponent - SUB_BUCKET_BITS;
+        int subBucket = static_cast<int>(value >> shift) - SUB_BUCKETS;
+        return LINEAR_LIMIT + (shift - 1) * SUB_BUCKETS + subBucket;
+    }
+
+    // Largest value that falls into bucket
+    static uint64_t bucketUpperBound(int bucket) {
+        if (bucket < LINEAR_LIMIT) return static_cast<uint64_t>(bucket);
+        int shift = (bucket - LINEAR_LIMIT) / SUB_BUCKETS + 1;
+        uint64_t subBucket = static_cast<uint64_t>((bucket - LINEAR_LIMIT) % SUB_BUCKETS + SUB_BUCKETS);
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() : buckets(NUM_BUCKETS, 0) {}
+
+    void record(uint64_t nanoseconds) {
+        ++buckets[bucketOf(nanoseconds)];
+        ++total;
+        maximum = std::max(maximum, nanoseconds);
+        sum += nanoseconds;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < NUM_BUCKETS; ++i) buckets[i] += other.buckets[i];
+        total += other.total;
+        maximum = std::max(maximum, other.maximum);
+        sum += other.sum;
+    }
+
+    void reset() {
+        std::fill(buckets.begin(), buckets.end(), 0);
+        total = maximum = 0;
+        sum = 0;
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t max() const {
+        return maximum;
+    }
+
+    double mean() const {
+        return total ? static_cast<double>(sum) / total : 0.0;
+    }
+
+    // Smallest bucket bound covering the given fraction of the samples (0 < q <= 1)
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return std::min(bucketUpperBound(i), maximum);
+        }
+        return maximum;
+    }
+
+    // Calls visit(upperBound, count) for each power-of-two range holding samples
+    template <typename Visitor>
+    void forEachOctave(Visitor visit) const {
+        int octave = 0;
+        uint64_t count = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            if (!buckets[i]) continue;
+            uint64_t bound = bucketUpperBound(i);
+            int bucketOctave = bound ? 64 - __builtin_clzll(bound) : 0;
+            if (bucketOctave != octave && count) {
+                visit(octave >= 64 ? ~0ULL : (1ULL << octave) - 1, count);
+                count = 0;
+            }
+            octave = bucketOctave;
+            count += buckets[i];
+        }
+        if (count) visit(octave >= 64 ? ~0ULL : (1ULL << octave) - 1, count);
+    }
+};
+
+// Stages of processing one transaction, in the order they run
+enum class Stage {
+    Validation,  // Account existence and balance
+    Bloom,       // Flagged-account check
+    DescriptionCache,  // Whole-description verdict lookup; every description check, hit or miss
+    BKTree,      // Typosquatting words, on description cache misses
+    Patterns,    // Suspicious description suffixes, on misses the BK-tree passed
+    Velocity,
+    Frequency,
+    Cycle,       // Graph update and cycle search
+    Commit,      // Balances, log, histories and detector state
+    Count
+};
+
+const int STAGE_COUNT = static_cast<int>(Stage::Count);
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Validation: return "validation";
+        case Stage::Bloom: return "bloom";
+        case Stage::DescriptionCache: return "description-cache";
+        case Stage::BKTree: return "bk-tree";
+        case Stage::Patterns: return "patterns";
+        case Stage::Velocity: return "velocity";
+        case Stage::Frequency: return "frequency";
+        case Stage::Cycle: return "cycle";
+        case Stage::Commit: return "commit";
+        case Stage::Count: break;
+    }
+    return "unknown";
+}
+
+// Per-thread cache-miss and instruction counters read through perf_event_open.
+// Unavailable (all reads fail) off Linux or when the kernel refuses access.
+class HardwareCounters {
+private:
+    int leader = -1;
+    int member = -1;
+
+#if defined(__linux__)
+    static int open(uint64_t config, int groupFD) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = groupFD < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFD, 0));
+    }
+#endif
+
+public:
+    HardwareCounters() {
+#if defined(__linux__)
+        leader = open(PERF_COUNT_HW_CACHE_MISSES, -1);
+        if (leader < 0) return;
+        member = open(PERF_COUNT_HW_INSTRUCTIONS, leader);
+        if (member < 0) {
+            ::close(leader);
+            leader = -1;
+            return;
+        }
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    ~HardwareCounters() {
+#if defined(__linux__)
+        if (member >= 0) ::close(member);
+        if (leader >= 0) ::close(leader);
+#endif
+    }
+
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+    bool available() const {
+        return leader >= 0;
+    }
+
+    // values[0]: cache misses, values[1]: instructions, both since the counters opened
+    bool read(uint64_t values[2]) const {
+#if defined(__linux__)
+        uint64_t buffer[3];  // Event count, then one value per event
+        if (leader >= 0 && ::read(leader, buffer, sizeof(buffer)) == static_cast<ssize_t>(sizeof(buffer))) {
+            values[0] = buffer[1];
+            values[1] = buffer[2];
+            return true;
+        }
+#endif
+        (void)values;
+        return false;
+    }
+};
+
+// Cheap timestamps for stage timing: the time-stamp counter where there is one,
+// converted to nanoseconds with a rate measured against steady_clock
+class StageClock {
+private:
+    double nanosPerTick = 1.0;
+
+public:
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Measures the tick rate over a few milliseconds
+    void calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+        auto wallStart = std::chrono::steady_clock::now();
+        uint64_t tickStart = ticks();
+        while (std::chrono::steady_clock::now() - wallStart < std::chrono::milliseconds(5)) {}
+        double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - wallStart).count();
+        nanosPerTick = nanos / static_cast<double>(ticks() - tickStart);
+#else
+        nanosPerTick = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+    }
+
+    uint64_t toNanoseconds(uint64_t tickCount) const {
+        return static_cast<uint64_t>(static_cast<double>(tickCount) * nanosPerTick);
+    }
+};
+
+// Process-wide per-stage instrumentation, off by default. Each thread records
+// into its own slot, so stage timers never contend; merged views (dump,
+// periodic reports) must be taken while no transaction is being processed,
+// which processBatch guarantees between chunks. When disabled a stage timer
+// costs one relaxed load.
+class StageProfiler {
+private:
+    struct ThreadMetrics {
+        LatencyHistogram latency[STAGE_COUNT];
+        uint64_t hits[STAGE_COUNT] = {};
+        uint64_t cacheMisses[STAGE_COUNT] = {};
+        uint64_t instructions[STAGE_COUNT] = {};
+        uint64_t countedCalls[STAGE_COUNT] = {};  // Calls with hardware counter readings
+    };
+
+    std::atomic<bool> active{false};
+    std::atomic<bool> countersWanted{false};
+    std::atomic<bool> dumpRequested{false};
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads;
+    std::chrono::steady_clock::duration reportInterval{0};
+    std::chrono::steady_clock::time_point lastReport;
+    StageClock clock;
+
+    ThreadMetrics& local() {
+        thread_local ThreadMetrics* metrics = nullptr;
+        if (!metrics) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            threads.push_back(std::make_unique<ThreadMetrics>());
+            metrics = threads.back().get();
+        }
+        return *metrics;
+    }
+
+    StageProfiler() = default;
+
+public:
+    static StageProfiler& instance() {
+        static StageProfiler profiler;
+        return profiler;
+    }
+
+    // hardwareCounters: also read perf counters around every stage (a syscall each)
+    void enable(bool hardwareCounters = false) {
+        clock.calibrate();
+        countersWanted.store(hardwareCounters, std::memory_order_relaxed);
+        lastReport = std::chrono::steady_clock::now();
+        active.store(true, std::memory_order_release);
+    }
+
+    void disable() {
+        active.store(false, std::memory_order_release);
+    }
+
+    bool enabled() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    bool countersEnabled() const {
+        return countersWanted.load(std::memory_order_relaxed);
+    }
+
+    // Report every interval from poll(); zero turns periodic reports off
+    void setReportInterval(std::chrono::steady_clock::duration interval) {
+        reportInterval = interval;
+    }
+
+    // Ask for a dump at the next poll(); safe to call from a signal handler
+    void requestDump() {
+        dumpRequested.store(true, std::memory_order_relaxed);
+    }
+
+    // Counters of the calling thread, opened on first use
+    static const HardwareCounters& threadCounters() {
+        thread_local HardwareCounters counters;
+        return counters;
+    }
+
+    void record(Stage stage, uint64_t elapsedTicks, bool hit, const uint64_t* counterDelta) {
+        ThreadMetrics& metrics = local();
+        int index = static_cast<int>(stage);
+        metrics.latency[index].record(clock.toNanoseconds(elapsedTicks));
+        metrics.hits[index] += hit;
+        if (counterDelta) {
+            metrics.cacheMisses[index] += counterDelta[0];
+            metrics.instructions[index] += counterDelta[1];
+            ++metrics.countedCalls[index];
+        }
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& metrics : threads) *metrics = ThreadMetrics();
+    }
+
+    // Per-stage calls, hits (the stage rejected the transaction, or committed it),
+    // latency percentiles in nanoseconds and, when recorded, counters per call
+    void dump(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        out << "Stage profile:" << std::endl;
+        for (int index = 0; index < STAGE_COUNT; ++index) {
+            LatencyHistogram latency;
+            uint64_t hits = 0, cacheMisses = 0, instructions = 0, countedCalls = 0;
+            for (const auto& metrics : threads) {
+                latency.merge(metrics->latency[index]);
+                hits += metrics->hits[index];
+                cacheMisses += metrics->cacheMisses[index];
+                instructions += metrics->instructions[index];
+                countedCalls += metrics->countedCalls[index];
+            }
+            out << "  " << stageName(static_cast<Stage>(index)) << ": calls " << latency.count() << ", hits " << hits
+                << ", ns p50 " << latency.percentile(0.50) << " p99 " << latency.percentile(0.99)
+                << " p999 " << latency.percentile(0.999) << " max " << latency.max()
+                << " mean " << latency.mean() << ", total ms " << latency.mean() * latency.count() / 1e6;
+            if (countedCalls) {
+                out << ", cache misses/call " << static_cast<double>(cacheMisses) / countedCalls
+                    << ", instructions/call " << static_cast<double>(instructions) / countedCalls;
+            }
+            out << std::endl;
+        }
+        if (countersEnabled() && !threadCounters().available()) {
+            out << "  (hardware counters unavailable: perf_event_open failed)" << std::endl;
+        }
+    }
+
+    // Dump if one was requested or the report interval has passed. Called by
+    // the processing thread between chunks.
+    void poll(std::ostream& out) {
+        if (!enabled()) return;
+        bool due = reportInterval.count() > 0 && std::chrono::steady_clock::now() - lastReport >= reportInterval;
+        if (dumpRequested.exchange(false, std::memory_order_relaxed) || due) {
+            dump(out);
+            lastReport = std::chrono::steady_clock::now();
+        }
+    }
+};
+
+// Times one stage of one transaction into the StageProfiler; call hit() when
+// the stage rejects the transaction
+class StageTimer {
+private:
+    Stage stage;
+    bool active;
+    bool fired = false;
+    bool counting = false;
+    uint64_t startCounters[2];
+    uint64_t start;
+
+public:
+    explicit StageTimer(Stage stage) : stage(stage), active(StageProfiler::instance().enabled()) {
+        if (!active) return;
+        if (StageProfiler::instance().countersEnabled()) {
+            counting = StageProfiler::threadCounters().read(startCounters);
+        }
+        start = StageClock::ticks();
+    }
+
+    ~StageTimer() {
+        if (!active) return;
+        uint64_t elapsed = StageClock::ticks() - start;
+        uint64_t endCounters[2];
+        uint64_t delta[2];
+        bool counted = counting && StageProfiler::threadCounters().read(endCounters);
+        if (counted) {
+            delta[0] = endCounters[0] - startCounters[0];
+            delta[1] = endCounters[1] - startCounters[1];
+        }
+        StageProfiler::instance().record(stage, elapsed, fired, counted ? delta : nullptr);
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    void hit() {
+        fired = true;
+    }
+};
+
+// Outcome of the description-only checks (typosquatting and suspicious patterns)
+struct DescriptionVerdict {
+    bool suspicious = false;
+    std::string reason;
+};
+
+// Typosquatting and suspicious pattern checks over a pair of dictionaries, memoized
+// per whole description and per case-folded word. A suspicious word's alert names
+// the dictionary word it resembles. check() is safe to call from several threads
+// at once.
+class DescriptionChecker {
+private:
+    const BKTree& bkTree;
+    const PatternAutomaton& patternAutomaton;
+    VerdictCache<DescriptionVerdict> descriptionVerdicts{ 1 << 16 };
+    VerdictCache<std::string> wordVerdicts{ 1 << 16 };  // Closest dictionary word, empty if none
+
+public:
+    DescriptionChecker(const BKTree& tree, const PatternAutomaton& automaton) : bkTree(tree), patternAutomaton(automaton) {}
+
+    // Drop cached verdicts if the dictionaries changed. Must not run concurrently
+    // with check().
+    void validate() {
+        uint64_t version = bkTree.version() + patternAutomaton.version();
+        descriptionVerdicts.validate(version);
+        wordVerdicts.validate(version);
+    }
+
+    DescriptionVerdict check(std::string_view view) {
+        DescriptionVerdict verdict;
+        thread_local std::string description;
+        {
+            StageTimer timer(Stage::DescriptionCache);
+            description.assign(view.data(), view.size());
+            if (descriptionVerdicts.lookup(description, verdict)) {
+                if (verdict.suspicious) timer.hit();
+                return verdict;
+            }
+        }
+
+        // Case-fold the description once; both detectors work on the folded copy,
+        // and words are views into it
+        thread_local std::string folded;
+        thread_local std::string key;
+        folded.resize(description.size());
+        foldAsciiCase(description.data(), description.size(), folded.data());
+
+        // Check for suspicious description using BK Tree (typosquatting). Words
+        // missing from the cache are searched for together in one batch.
+        {
+            StageTimer timer(Stage::BKTree);
+            thread_local std::vector<std::string_view> words, unseen;
+            thread_local std::vector<std::string> cached;   // Per word, when it was in the cache
+            thread_local std::vector<size_t> unseenIndex;   // Per word, its place in unseen, or NOT_SEARCHED
+            thread_local std::vector<std::vector<BKTree::Match>> matches;
+            thread_local BKTree::SearchScratch scratch;
+            const size_t NOT_SEARCHED = ~static_cast<size_t>(0);
+
+            words.clear();
+            unseen.clear();
+            WordTokenizer tokenizer(folded);
+            std::string_view word;
+            while (tokenizer.next(word)) words.push_back(word);
+            if (cached.size() < words.size()) cached.resize(words.size());
+            unseenIndex.resize(words.size());
+            for (size_t i = 0; i < words.size(); ++i) {
+                key.assign(words[i].data(), words[i].size());
+                unseenIndex[i] = NOT_SEARCHED;
+                if (wordVerdicts.lookup(key, cached[i])) continue;
+                unseenIndex[i] = std::find(unseen.begin(), unseen.end(), words[i]) - unseen.begin();
+                if (unseenIndex[i] == unseen.size()) unseen.push_back(words[i]);
+            }
+            if (!unseen.empty()) {
+                bkTree.searchBatch(unseen.data(), unseen.size(), 2, 1, scratch, matches);  // Levenshtein distance <= 2
+                for (size_t j = 0; j < unseen.size(); ++j) {
+                    key.assign(unseen[j].data(), unseen[j].size());
+                    wordVerdicts.store(key, matches[j].empty() ? std::string() : std::string(matches[j][0].word));
+                }
+            }
+
+            for (size_t i = 0; i < words.size(); ++i) {
+                std::string_view closest = cached[i];
+                if (unseenIndex[i] != NOT_SEARCHED) {
+                    const std::vector<BKTree::Match>& found = matches[unseenIndex[i]];
+                    closest = found.empty() ? std::string_view() : found[0].word;
+                }
+                if (closest.empty()) continue;
+                verdict.suspicious = true;
+                // Alerts quote the word as written
+                verdict.reason = "Suspicious word detected: '" +
+                                 description.substr(words[i].data() - folded.data(), words[i].size()) +
+                                 "' (resembles '" + std::string(closest) + "')";
+                timer.hit();
+                break;
+            }
+        }
+
+        // Check for suspicious patterns using the pattern automaton
+        if (!verdict.suspicious) {
+            StageTimer timer(Stage::Patterns);
+            if (const std::string* pattern = patternAutomaton.matchSuffix(folded)) {
+                verdict.suspicious = true;
+                verdict.reason = "Suspicious pattern detected: '" + *pattern + "'";
+                timer.hit();
+            }
+        }
+
+        descriptionVerdicts.store(description, verdict);
+        return verdict;
+    }
+
+    void printStatistics(std::ostream& out = std::cout) const {
+        out << "Verdict cache: descriptions " << descriptionVerdicts.hitCount() << " hits / "
+                  << descriptionVerdicts.missCount() << " misses, words " << wordVerdicts.hitCount()
+                  << " hits / " << wordVerdicts.missCount() << " misses." << std::endl;
+    }
+};
+
+// Blocked Bloom Filter for fast flagged account detection.
+// Every key maps to one 64-byte block and sets all of its bits inside it, so a
+// probe touches a single cache line. Sized at runtime from the expected number
+// of keys and the target false-positive rate.
+class BloomFilter {
+private:
+    static constexpr size_t BLOCK_BITS = 512;
+    static constexpr size_t WORDS_PER_BLOCK = BLOCK_BITS / 64;
+
+    struct alignas(64) Block {
+        uint64_t words[WORDS_PER_BLOCK];
+    };
+
+    std::vector<Block> blocks;
+    int numHashFunctions;
+
+    size_t blockIndex(uint64_t h) const {
+        // Map the high 32 bits onto [0, blocks.size()) without a division
+        return static_cast<size_t>(((h >> 32) * blocks.size()) >> 32);
+    }
+
+    // Expected false-positive rate of a blocked filter: keys per block are Poisson
+    // distributed, and crowded blocks answer yes far more often than average
+    static double blockedFalsePositiveRate(size_t numItems, size_t numBlocks, int numHashes) {
+        double lambda = static_cast<double>(numItems) / numBlocks;
+        double rate = 0.0, probability = std::exp(-lambda);
+        int limit = static_cast<int>(lambda + 10 * std::sqrt(lambda) + 10);
+        for (int i = 0; i <= limit; ++i) {
+            double bitSet = 1.0 - std::pow(1.0 - 1.0 / BLOCK_BITS, static_cast<double>(numHashes) * i);
+            rate += probability * std::pow(bitSet, numHashes);
+            probability *= lambda / (i + 1);
+        }
+        return rate;
+    }
+
+    // Calls visit(bit) for each of the key's bit positions within its block. The
+    // positions are 9-bit slices of the hash below the block index, rehashed as
+    // they run out.
+    template <typename Visit>
+    static bool forEachBit(uint64_t h, int numHashes, Visit visit) {
+        uint64_t bits = h;
+        int available = 3;
+        for (int i = 0; i < numHashes; ++i) {
+            if (available == 0) {
+                bits = mix64(bits);
+                available = 7;
+            }
+            if (!visit(static_cast<uint32_t>(bits % BLOCK_BITS))) return false;
+            bits /= BLOCK_BITS;
+            --available;
+        }
+        return true;
+    }
+
+    static bool testBits(const Block& block, uint64_t h, int numHashes) {
+        return forEachBit(h, numHashes, [&](uint32_t bit) {
+            return (block.words[bit / 64] & (1ULL << (bit % 64))) != 0;
+        });
+    }
+
+public:
+    BloomFilter(size_t expectedItems, double falsePositiveRate) {
+        expectedItems = std::max<size_t>(expectedItems, 1);
+        falsePositiveRate = std::min(std::max(falsePositiveRate, 1e-9), 0.5);
+        const double ln2 = std::log(2.0);
+        double bitsPerItem = -std::log(falsePositiveRate) / (ln2 * ln2);
+        numHashFunctions = std::max(1, static_cast<int>(std::round(bitsPerItem * ln2)));
+        size_t numBits = static_cast<size_t>(std::ceil(bitsPerItem * expectedItems));
+        size_t numBlocks = std::max<size_t>(1, (numBits + BLOCK_BITS - 1) / BLOCK_BITS);
+        // Blocking costs accuracy; grow the filter until the estimate meets the target
+        while (blockedFalsePositiveRate(expectedItems, numBlocks, numHashFunctions) > falsePositiveRate) {
+            numBlocks += numBlocks / 16 + 1;
+        }
+        blocks.assign(numBlocks, Block{});
+    }
+
+    void insert(int accountID) {
+        uint64_t h = mix64(static_cast<uint32_t>(accountID));
+        Block& block = blocks[blockIndex(h)];
+        forEachBit(h, numHashFunctions, [&](uint32_t bit) {
+            block.words[bit / 64] |= 1ULL << (bit % 64);
+            return true;
+        });
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.writeVector(blocks);
+        out.write(numHashFunctions);
+    }
+
+    bool load(SnapshotReader& in) {
+        return in.readVector(blocks) && in.read(numHashFunctions) && !blocks.empty() && numHashFunctions >= 1 &&
+               numHashFunctions <= 64;
+    }
+
+    bool possiblyExists(int accountID) const {
+        uint64_t h = mix64(static_cast<uint32_t>(accountID));
+        return testBits(blocks[blockIndex(h)], h, numHashFunctions);
+    }
+
+    // Probe several accounts at once: all blocks are prefetched before any is tested
+    void possiblyExistsBatch(const int* accountIDs, size_t count, bool* results) const {
+        constexpr size_t CHUNK = 16;
+        uint64_t hashes[CHUNK];
+        for (size_t base = 0; base < count; base += CHUNK) {
+            size_t n = std::min(CHUNK, count - base);
+            for (size_t i = 0; i < n; ++i) {
+                hashes[i] = mix64(static_cast<uint32_t>(accountIDs[base + i]));
+#if defined(__GNUC__)
+                __builtin_prefetch(&blocks[blockIndex(hashes[i])]);
+#endif
+            }
+            for (size_t i = 0; i < n; ++i) {
+                results[base + i] = testBits(blocks[blockIndex(hashes[i])], hashes[i], numHashFunctions);
+            }
+        }
+    }
+};
+
+// Open-addressing hash map from 64-bit keys to small values, stored as one flat
+// array of (key, value) slots with linear probing. The key ~0 marks empty slots,
+// so an entry with that key is kept in a separate slot.
+template <typename Value>
+class FlatHashMap {
+private:
+    static constexpr uint64_t EMPTY_KEY = ~0ULL;
+
+    struct Slot {
+        uint64_t key;
+        Value value;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    Slot reservedKeySlot{ EMPTY_KEY, Value{} };
+    bool hasReservedKey = false;
+
+    size_t slotIndex(uint64_t key) const {
+        size_t mask = slots.size() - 1;
+        size_t i = mix64(key) & mask;
+        while (slots[i].key != EMPTY_KEY && slots[i].key != key) i = (i + 1) & mask;
+        return i;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.assign(capacity, Slot{ EMPTY_KEY, Value{} });
+        for (const Slot& slot : old) {
+            if (slot.key != EMPTY_KEY) slots[slotIndex(slot.key)] = slot;
+        }
+    }
+
+public:
+    FlatHashMap() {
+        rehash(16);
+    }
+
+    // Make room for n keys without further rehashing
+    void reserve(size_t n) {
+        size_t capacity = slots.size();
+        while (n * 10 > capacity * 7) capacity *= 2;
+        if (capacity != slots.size()) rehash(capacity);
+    }
+
+    // Lookup without insertion
+    const Value* find(uint64_t key) const {
+        if (key == EMPTY_KEY) return hasReservedKey ? &reservedKeySlot.value : nullptr;
+        const Slot& slot = slots[slotIndex(key)];
+        return slot.key == key ? &slot.value : nullptr;
+    }
+
+    Value* find(uint64_t key) {
+        return const_cast<Value*>(static_cast<const FlatHashMap*>(this)->find(key));
+    }
+
+    // Lookup, inserting a value-initialized entry if the key is absent
+    Value& operator[](uint64_t key) {
+        if (key == EMPTY_KEY) {
+            count += !hasReservedKey;
+            hasReservedKey = true;
+            return reservedKeySlot.value;
+        }
+        size_t i = slotIndex(key);
+        if (slots[i].key != key) {
+            if ((count + 1) * 10 > slots.size() * 7) {
+                rehash(slots.size() * 2);
+                i = slotIndex(key);
+            }
+            slots[i] = { key, Value{} };
+            ++count;
+        }
+        return slots[i].value;
+    }
+
+    // Remove the key if present. Later entries of its probe run shift back into
+    // the gap, so lookups never need tombstones.
+    bool erase(uint64_t key) {
+        if (key == EMPTY_KEY) {
+            if (!hasReservedKey) return false;
+            hasReservedKey = false;
+            reservedKeySlot.value = Value{};
+            --count;
+            return true;
+        }
+        size_t mask = slots.size() - 1;
+        size_t hole = slotIndex(key);
+        if (slots[hole].key != key) return false;
+        for (size_t i = (hole + 1) & mask; slots[i].key != EMPTY_KEY; i = (i + 1) & mask) {
+            size_t home = mix64(slots[i].key) & mask;
+            // Move the entry unless its home lies cyclically in (hole, i]
+            bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+            if (!stays) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = { EMPTY_KEY, Value{} };
+        --count;
+        return true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // The slot array is stored as is, so loading needs no rehash
+    void save(SnapshotWriter& out) const {
+        out.writeVector(slots);
+        out.write<uint64_t>(count);
+        out.write(reservedKeySlot);
+        out.write(hasReservedKey);
+    }
+
+    // Rejects a table whose entry count disagrees with its slots or that is
+    // fuller than the load factor allows, since probing relies on free slots
+    bool load(SnapshotReader& in) {
+        uint64_t loadedCount = 0;
+        uint8_t reserved = 0;
+        static_assert(sizeof(reserved) == sizeof(hasReservedKey), "flag is saved as one byte");
+        if (!in.readVector(slots) || !in.read(loadedCount) || !in.read(reservedKeySlot) || !in.read(reserved) ||
+            slots.empty() || (slots.size() & (slots.size() - 1)) != 0 || reserved > 1 ||
+            reservedKeySlot.key != EMPTY_KEY) {
+            return false;
+        }
+        size_t occupied = 0;
+        for (const Slot& slot : slots) occupied += slot.key != EMPTY_KEY;
+        if (occupied * 10 > slots.size() * 7 || occupied + reserved != loadedCount) return false;
+        count = loadedCount;
+        hasReservedKey = reserved != 0;
+        if (!hasReservedKey) reservedKeySlot.value = Value{};
+        return true;
+    }
+
+    // Calls f(key, value) for every entry, in slot order
+    template <typename F>
+    void forEach(F f) const {
+        for (const Slot& slot : slots) {
+            if (slot.key != EMPTY_KEY) f(slot.key, slot.value);
+        }
+        if (hasReservedKey) f(reservedKeySlot.key, reservedKeySlot.value);
+    }
+};
+
+// Running totals of the transfers accepted from one account to another
+struct EdgeStats {
+    uint32_t count;
+    double totalAmount;
+    long long lastTimestamp;
+};
+
+// Per (sender, receiver) pair statistics in one flat table keyed by the packed pair
+class EdgeStatsTable {
+private:
+    FlatHashMap<EdgeStats> table;
+
+    static uint64_t pairKey(int senderID, int receiverID) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(senderID)) << 32) | static_cast<uint32_t>(receiverID);
+    }
+
+public:
+    // Statistics for the pair, or nullptr if it has never transacted
+    const EdgeStats* find(int senderID, int receiverID) const {
+        return table.find(pairKey(senderID, receiverID));
+    }
+
+    void record(int senderID, int receiverID, double amount, long long timestamp) {
+        EdgeStats& stats = table[pairKey(senderID, receiverID)];
+        ++stats.count;
+        stats.totalAmount += amount;
+        stats.lastTimestamp = timestamp;
+    }
+
+    // Take a transfer recorded earlier back out of the totals, dropping the
+    // pair once none of its transfers remain
+    void forget(int senderID, int receiverID, double amount) {
+        uint64_t key = pairKey(senderID, receiverID);
+        EdgeStats* stats = table.find(key);
+        if (!stats) return;
+        if (--stats->count == 0) {
+            table.erase(key);
+        } else {
+            stats->totalAmount -= amount;
+        }
+    }
+
+    // Frequent Transactions to the Same Account: would this transfer make the
+    // pair's count and total reach both thresholds?
+    bool exceedsFrequencyLimit(int senderID, int receiverID, double amount) const {
+        const int TRANSACTION_THRESHOLD = 3;
+        const double AMOUNT_THRESHOLD = 50000.0;  // Example threshold
+
+        const EdgeStats* stats = find(senderID, receiverID);
+        int count = (stats ? static_cast<int>(stats->count) : 0) + 1;
+        double totalAmount = (stats ? stats->totalAmount : 0.0) + amount;
+        return count >= TRANSACTION_THRESHOLD && totalAmount >= AMOUNT_THRESHOLD;
+    }
+
+    void reserve(size_t pairs) {
+        table.reserve(pairs);
+    }
+
+    size_t size() const {
+        return table.size();
+    }
+
+    void save(SnapshotWriter& out) const {
+        table.save(out);
+    }
+
+    bool load(SnapshotReader& in) {
+        return table.load(in);
+    }
+
+    // Calls f(senderID, receiverID, stats) for every pair
+    template <typename F>
+    void forEach(F f) const {
+        table.forEach([&](uint64_t key, const EdgeStats& stats) {
+            f(static_cast<int>(static_cast<uint32_t>(key >> 32)), static_cast<int>(static_cast<uint32_t>(key)), stats);
+        });
+    }
+};
+
+// Assigns each distinct string a dense 32-bit ID
+class StringInterner {
+private:
+    std::deque<std::string> strings;                        // Stable storage, indexed by ID
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+public:
+    uint32_t intern(std::string_view value) {
+        auto it = ids.find(value);
+        if (it != ids.end()) return it->second;
+        strings.emplace_back(value);
+        uint32_t id = static_cast<uint32_t>(strings.size() - 1);
+        ids.emplace(strings.back(), id);
+        return id;
+    }
+
+    // Returns false if the string was never interned
+    bool find(std::string_view value, uint32_t& id) const {
+        auto it = ids.find(value);
+        if (it == ids.end()) return false;
+        id = it->second;
+        return true;
+    }
+
+    const std::string& lookup(uint32_t id) const {
+        return strings[id];
+    }
+
+    size_t size() const {
+        return strings.size();
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.write<uint64_t>(strings.size());
+        for (const auto& value : strings) out.writeString(value);
+    }
+
+    // Strings are re-interned in ID order, so every ID keeps its string
+    bool load(SnapshotReader& in) {
+        uint64_t count = 0;
+        if (!in.readCount(count, sizeof(uint64_t))) return false;
+        ids.clear();
+        strings.clear();
+        std::string value;
+        for (uint64_t i = 0; i < count && in.readString(value); ++i) intern(value);
+        return in.good() && strings.size() == count;
+    }
+};
+
+// Flagged accounts: a Bloom filter answers most probes from one cache line, and
+// an exact set confirms its hits so a false positive never rejects a transfer
+class FlaggedAccountSet {
+private:
+    BloomFilter bloomFilter;
+    std::unordered_set<int> accounts;
+
+public:
+    FlaggedAccountSet(size_t expectedAccounts, double falsePositiveRate) : bloomFilter(expectedAccounts, falsePositiveRate) {}
+
+    void insert(int accountID) {
+        if (accounts.insert(accountID).second) {
+            bloomFilter.insert(accountID);
+        }
+    }
+
+    bool contains(int accountID) const {
+        return bloomFilter.possiblyExists(accountID) && accounts.count(accountID);
+    }
+
+    // True if either account is flagged; both are probed in one batch
+    bool containsEither(int first, int second) const {
+        const int ids[2] = { first, second };
+        bool maybe[2];
+        bloomFilter.possiblyExistsBatch(ids, 2, maybe);
+        return (maybe[0] && accounts.count(first)) || (maybe[1] && accounts.count(second));
+    }
+
+    size_t size() const {
+        return accounts.size();
+    }
+
+    void save(SnapshotWriter& out) const {
+        bloomFilter.save(out);
+        std::vector<int> ids(accounts.begin(), accounts.end());
+        out.writeVector(ids);
+    }
+
+    bool load(SnapshotReader& in) {
+        std::vector<int> ids;
+        if (!bloomFilter.load(in) || !in.readVector(ids)) return false;
+        accounts.clear();
+        accounts.reserve(ids.size());
+        accounts.insert(ids.begin(), ids.end());
+        return true;
+    }
+};
+
+// Fixed-size record of an accepted transaction
+struct TransactionRecord {
+    uint64_t transactionKey;  // See TransactionLog::encodeID
+    long long timestamp;
+    double amount;
+    int senderAccountID;
+    int receiverAccountID;
+    uint32_t descriptionID;   // Interned description
+};
+
+// Log of accepted transactions with an integer index by transaction ID.
+// Records are numbered in append order and keep their numbers for life; the
+// oldest can be evicted, after which the log covers [beginIndex(), endIndex()).
+class TransactionLog {
+private:
+    static constexpr uint64_t INTERNED_ID = 1ULL << 63;
+    static constexpr int WIDTH_SHIFT = 58;
+
+    std::vector<TransactionRecord> records;    // records[0] has index base
+    uint32_t base = 0;
+    uint32_t first = 0;                        // Index of the oldest record kept
+    StringInterner descriptions;
+    StringInterner irregularIDs;               // IDs that are not short digit strings
+    FlatHashMap<uint32_t> latestByID;          // Transaction key -> newest record index
+
+    static bool isShortNumber(std::string_view id) {
+        return !id.empty() && id.size() < 18 &&
+               std::all_of(id.begin(), id.end(), [](char c) { return c >= '0' && c <= '9'; });
+    }
+
+    // Key of a short digit string
+    static uint64_t numberKey(std::string_view id) {
+        uint64_t value = 0;
+        std::from_chars(id.data(), id.data() + id.size(), value);
+        return (static_cast<uint64_t>(id.size()) << WIDTH_SHIFT) | value;
+    }
+
+public:
+    // Digit strings of up to 17 characters become their value tagged with the
+    // string's width, so "000042" and "42" stay distinct and print back
+    // unchanged. Anything else is interned.
+    uint64_t encodeID(std::string_view id) {
+        if (isShortNumber(id)) return numberKey(id);
+        return INTERNED_ID | irregularIDs.intern(id);
+    }
+
+    // Like encodeID, but never interns; returns false for an unknown irregular ID
+    bool findKey(std::string_view id, uint64_t& key) const {
+        if (isShortNumber(id)) {
+            key = numberKey(id);
+            return true;
+        }
+        uint32_t internedID;
+        if (!irregularIDs.find(id, internedID)) return false;
+        key = INTERNED_ID | internedID;
+        return true;
+    }
+
+    std::string decodeID(uint64_t key) const {
+        if (key & INTERNED_ID) return irregularIDs.lookup(static_cast<uint32_t>(key));
+        std::string digits = std::to_string(key & ((1ULL << WIDTH_SHIFT) - 1));
+        size_t width = static_cast<size_t>(key >> WIDTH_SHIFT);
+        return std::string(width > digits.size() ? width - digits.size() : 0, '0') + digits;
+    }
+
+    uint32_t append(const TransactionView& tx) {
+        uint32_t index = endIndex();
+        uint64_t key = encodeID(tx.transactionID);
+        records.push_back({ key, tx.timestamp, tx.amount, tx.senderAccountID, tx.receiverAccountID,
+                            descriptions.intern(tx.description) });
+        latestByID[key] = index;
+        return index;
+    }
+
+    const TransactionRecord* find(const std::string& transactionID) const {
+        uint64_t key;
+        if (!findKey(transactionID, key)) return nullptr;
+        const uint32_t* index = latestByID.find(key);
+        return index ? &records[*index - base] : nullptr;
+    }
+
+    Transaction materialize(const TransactionRecord& record) const {
+        return { decodeID(record.transactionKey), record.senderAccountID, record.receiverAccountID,
+                 record.amount, record.timestamp, descriptions.lookup(record.descriptionID) };
+    }
+
+    // True unless a later record reused this record's transaction ID
+    bool isLatest(uint32_t index) const {
+        return *latestByID.find(records[index - base].transactionKey) == index;
+    }
+
+    const TransactionRecord& operator[](uint32_t index) const {
+        return records[index - base];
+    }
+
+    uint32_t beginIndex() const {
+        return first;
+    }
+
+    uint32_t endIndex() const {
+        return base + static_cast<uint32_t>(records.size());
+    }
+
+    size_t size() const {
+        return endIndex() - first;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const TransactionRecord& oldest() const {
+        return records[first - base];
+    }
+
+    // Drop the oldest record. Storage is reclaimed once half of it is evicted,
+    // so eviction costs amortized constant time.
+    void evictOldest() {
+        const TransactionRecord& record = records[first - base];
+        const uint32_t* latest = latestByID.find(record.transactionKey);
+        if (latest && *latest == first) latestByID.erase(record.transactionKey);
+        ++first;
+        if ((first - base) * 2 >= records.size()) {
+            records.erase(records.begin(), records.begin() + (first - base));
+            base = first;
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.write(first);
+        out.writeArray(records.data() + (first - base), size());
+        descriptions.save(out);
+        irregularIDs.save(out);
+        latestByID.save(out);
+    }
+
+    // Every record must name interned strings and be indexed by latestByID,
+    // and every index entry must point at a kept record with its key
+    bool load(SnapshotReader& in) {
+        bool ok = in.read(first) && in.readVector(records) && descriptions.load(in) && irregularIDs.load(in) &&
+                  latestByID.load(in);
+        base = first;
+        if (!ok || records.size() > std::numeric_limits<uint32_t>::max() - first) return false;
+        for (uint32_t index = first; index < endIndex(); ++index) {
+            const TransactionRecord& record = records[index - base];
+            if (record.descriptionID >= descriptions.size()) return false;
+            if ((record.transactionKey & INTERNED_ID) && (record.transactionKey & ~INTERNED_ID) >= irregularIDs.size()) {
+                return false;
+            }
+            const uint32_t* latest = latestByID.find(record.transactionKey);
+            if (!latest || *latest < index || *latest >= endIndex()) return false;
+        }
+        latestByID.forEach([&](uint64_t key, uint32_t index) {
+            ok = ok && index >= first && index < endIndex() && records[index - base].transactionKey == key;
+        });
+        return ok;
+    }
+};
+
+// Accounts in dense storage. Each account ID maps to an index once, through a
+// single flat hash probe, and the balance the checks touch on every transaction
+// lives in an array parallel to the IDs. Transaction histories, read only when
+// committing, are kept apart so they never share cache lines with the hot
+// fields. Flags are not stored here: they stay in FlaggedAccountSet.
+class AccountTable {
+private:
+    FlatHashMap<uint32_t> indexOf;                 // Account ID -> index + 1
+    std::vector<int> ids;
+    std::vector<double> balances;
+    std::vector<std::vector<uint32_t>> histories;  // Transaction log indices, oldest first
+
+public:
+    static constexpr uint32_t NONE = ~0u;
+
+    // The account's index, or NONE
+    uint32_t find(int accountID) const {
+        const uint32_t* entry = indexOf.find(static_cast<uint32_t>(accountID));
+        return entry ? *entry - 1 : NONE;
+    }
+
+    // Adds the account and returns its index, or NONE if it already exists
+    uint32_t add(int accountID, double balance) {
+        uint32_t& entry = indexOf[static_cast<uint32_t>(accountID)];
+        if (entry != 0) return NONE;
+        ids.push_back(accountID);
+        balances.push_back(balance);
+        histories.emplace_back();
+        entry = static_cast<uint32_t>(ids.size());
+        return entry - 1;
+    }
+
+    // Make room for n accounts in total without further reallocation
+    void reserve(size_t n) {
+        indexOf.reserve(n);
+        ids.reserve(n);
+        balances.reserve(n);
+        histories.reserve(n);
+    }
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    bool empty() const {
+        return ids.empty();
+    }
+
+    int id(uint32_t index) const {
+        return ids[index];
+    }
+
+    double& balance(uint32_t index) {
+        return balances[index];
+    }
+
+    double balance(uint32_t index) const {
+        return balances[index];
+    }
+
+    std::vector<uint32_t>& history(uint32_t index) {
+        return histories[index];
+    }
+
+    const std::vector<uint32_t>& history(uint32_t index) const {
+        return histories[index];
+    }
+
+    // History entries below firstIndex (evicted from the log) are left out
+    void save(SnapshotWriter& out, uint32_t firstIndex) const {
+        indexOf.save(out);
+        out.writeVector(ids);
+        out.writeVector(balances);
+        std::vector<uint64_t> offsets(1, 0);
+        std::vector<uint32_t> entries;
+        offsets.reserve(histories.size() + 1);
+        for (const auto& history : histories) {
+            entries.insert(entries.end(), std::lower_bound(history.begin(), history.end(), firstIndex), history.end());
+            offsets.push_back(entries.size());
+        }
+        out.writeVector(offsets);
+        out.writeVector(entries);
+    }
+
+    bool load(SnapshotReader& in) {
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> entries;
+        if (!indexOf.load(in) || !in.readVector(ids) || !in.readVector(balances) ||
+            !in.readVector(offsets) || !in.readVector(entries) || balances.size() != ids.size() ||
+            offsets.size() != ids.size() + 1 || offsets.back() != entries.size()) {
+            return false;
+        }
+        bool ok = indexOf.size() == ids.size();
+        indexOf.forEach([&](uint64_t key, uint32_t entry) {
+            ok = ok && entry >= 1 && entry <= ids.size() && static_cast<uint32_t>(ids[entry - 1]) == key;
+        });
+        if (!ok) return false;
+        histories.assign(ids.size(), {});
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > entries.size() ||
+                !std::is_sorted(entries.begin() + offsets[i], entries.begin() + offsets[i + 1])) {
+                return false;
+            }
+            histories[i].assign(entries.begin() + offsets[i], entries.begin() + offsets[i + 1]);
+        }
+        return true;
+    }
+
+    // Whether every history entry is a log index in [begin, end); checked once
+    // the log has loaded too
+    bool historiesWithin(uint32_t begin, uint32_t end) const {
+        for (const auto& history : histories) {
+            if (!history.empty() && (history.front() < begin || history.back() >= end)) return false;
+        }
+        return true;
+    }
+};
+
+// Sliding-window velocity tracking.
+// Each account owns a ring of the timestamps of its most recent `limit` accepted
+// transactions (sent or received), stored contiguously, so a check scans at most
+// one small fixed-size ring no matter how long the account's history is.
+// Rings are addressed either by account ID, assigned on first use, or directly
+// by a slot the caller already has, such as a dense account index; one tracker
+// uses one scheme.
+class VelocityTracker {
+private:
+    struct Ring {
+        uint32_t head;   // Slot that receives the next timestamp
+        uint32_t count;  // Filled slots, at most limit
+    };
+
+    long long timeWindow;
+    int limit;
+    std::unordered_map<int, uint32_t> ringOf;  // Account ID -> ring index
+    std::vector<Ring> rings;
+    std::vector<long long> timestamps;         // rings.size() * limit slots
+
+public:
+    VelocityTracker(long long window, int maxTransactions) : timeWindow(window), limit(std::max(1, maxTransactions)) {}
+
+    // Change the window and limit; each ring keeps its most recent timestamps
+    void configure(long long window, int maxTransactions) {
+        int newLimit = std::max(1, maxTransactions);
+        std::vector<long long> resized(rings.size() * newLimit);
+        for (size_t r = 0; r < rings.size(); ++r) {
+            uint32_t keep = std::min<uint32_t>(rings[r].count, newLimit);
+            for (uint32_t i = 0; i < keep; ++i) {
+                // Oldest kept first, so the new ring starts at slot keep % newLimit
+                uint32_t age = keep - i;
+                uint32_t slot = (rings[r].head + limit - age) % limit;
+                resized[r * newLimit + i] = timestamps[r * limit + slot];
+            }
+            rings[r] = { keep % newLimit, keep };
+        }
+        timestamps.swap(resized);
+        timeWindow = window;
+        limit = newLimit;
+    }
+
+    long long window() const {
+        return timeWindow;
+    }
+
+    int maxTransactions() const {
+        return limit;
+    }
+
+    // True when the account's last `limit` transactions all fall within the window
+    bool exceeds(int accountID, long long currentTimestamp) const {
+        auto it = ringOf.find(accountID);
+        return it != ringOf.end() && exceedsSlot(it->second, currentTimestamp);
+    }
+
+    bool exceedsSlot(uint32_t slot, long long currentTimestamp) const {
+        if (slot >= rings.size() || rings[slot].count < static_cast<uint32_t>(limit)) return false;
+        const long long* slots = &timestamps[static_cast<size_t>(slot) * limit];
+        long long oldest = *std::min_element(slots, slots + limit);
+        // Measured as an unsigned distance, as timestamps far apart would
+        // overflow a signed difference
+        return timeWindow >= 0 &&
+               (currentTimestamp <= oldest ||
+                static_cast<unsigned long long>(currentTimestamp) - static_cast<unsigned long long>(oldest) <=
+                    static_cast<unsigned long long>(timeWindow));
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.write(timeWindow);
+        out.write(limit);
+        std::vector<int> accountIDs;
+        std::vector<uint32_t> ringIDs;
+        accountIDs.reserve(ringOf.size());
+        ringIDs.reserve(ringOf.size());
+        for (const auto& entry : ringOf) {
+            accountIDs.push_back(entry.first);
+            ringIDs.push_back(entry.second);
+        }
+        out.writeVector(accountIDs);
+        out.writeVector(ringIDs);
+        out.writeVector(rings);
+        out.writeVector(timestamps);
+    }
+
+    bool load(SnapshotReader& in) {
+        std::vector<int> accountIDs;
+        std::vector<uint32_t> ringIDs;
+        if (!in.read(timeWindow) || !in.read(limit) || !in.readVector(accountIDs) || !in.readVector(ringIDs) ||
+            !in.readVector(rings) || !in.readVector(timestamps) || accountIDs.size() != ringIDs.size() || limit < 1 ||
+            timeWindow < 0 || timestamps.size() != rings.size() * limit) {
+            return false;
+        }
+        for (const Ring& ring : rings) {
+            if (ring.head >= static_cast<uint32_t>(limit) || ring.count > static_cast<uint32_t>(limit)) return false;
+        }
+        for (uint32_t ring : ringIDs) {
+            if (ring >= rings.size()) return false;
+        }
+        ringOf.clear();
+        ringOf.reserve(accountIDs.size());
+        for (size_t i = 0; i < accountIDs.size(); ++i) ringOf.emplace(accountIDs[i], ringIDs[i]);
+        return true;
+    }
+
+    void record(int accountID, long long timestamp) {
+        auto it = ringOf.find(accountID);
+        if (it == ringOf.end()) {
+            it = ringOf.emplace(accountID, static_cast<uint32_t>(rings.size())).first;
+        }
+        recordSlot(it->second, timestamp);
+    }
+
+    void recordSlot(uint32_t slot, long long timestamp) {
+        if (slot >= rings.size()) {
+            rings.resize(static_cast<size_t>(slot) + 1, Ring{ 0, 0 });
+            timestamps.resize(rings.size() * limit);
+        }
+        Ring& ring = rings[slot];
+        timestamps[static_cast<size_t>(slot) * limit + ring.head] = timestamp;
+        ring.head = (ring.head + 1) % limit;
+        ring.count = std::min<uint32_t>(ring.count + 1, limit);
+    }
+
+    // Make room for slots [0, count) up front
+    void reserveSlots(size_t count) {
+        if (count > rings.size()) {
+            rings.resize(count, Ring{ 0, 0 });
+            timestamps.resize(rings.size() * limit);
+        }
+    }
+};
+
+// Adjacency list that is also a FIFO: edges are appended at the back and, when
+// they expire, removed from the front, the oldest first. Iteration covers the
+// live edges only.
+class EdgeList {
+private:
+    std::vector<uint32_t> nodes;
+    uint32_t head = 0;  // Expired edges before this position await compaction
+
+public:
+    const uint32_t* begin() const {
+        return nodes.data() + head;
+    }
+
+    const uint32_t* end() const {
+        return nodes.data() + nodes.size();
+    }
+
+    void push_back(uint32_t node) {
+        nodes.push_back(node);
+    }
+
+    void pop_back() {
+        nodes.pop_back();
+    }
+
+    // Storage is reclaimed once half of it has expired
+    void popFront() {
+        if (++head * 2 >= nodes.size()) {
+            nodes.erase(nodes.begin(), nodes.begin() + head);
+            head = 0;
+        }
+    }
+
+    void assign(const uint32_t* first, const uint32_t* last) {
+        nodes.assign(first, last);
+        head = 0;
+    }
+
+    void clear() {
+        nodes.clear();
+        head = 0;
+    }
+};
+
+// Directed graph of transfers between accounts, used for circular transaction
+// detection. Accounts get dense node indices; each node keeps successor and
+// predecessor lists. Cycle searches reuse generation-stamped visit marks and
+// frontier buffers, so they allocate nothing once warmed up. A search only
+// reads the graph, so several threads may search it at once, each with its own
+// CycleSearch, as long as nothing changes it meanwhile.
+// With age tracking on, every edge is also queued with its transfer's
+// timestamp so edges can expire in the order they were added.
+class TransactionGraph {
+public:
+    // Visit marks and frontiers of one cycle search at a time
+    class CycleSearch {
+    private:
+        friend class TransactionGraph;
+        std::vector<uint32_t> forwardMark, backwardMark;  // == generation when visited
+        uint32_t generation = 0;
+        uint32_t start = 0;
+        std::vector<uint32_t> forwardFrontier, backwardFrontier, nextFrontier;
+
+        // After a search without a cycle: unmark the last frontiers, so the
+        // marks hold only the nodes whose edges the search followed
+        void unmarkFrontiers() {
+            for (uint32_t node : forwardFrontier) forwardMark[node] = 0;
+            for (uint32_t node : backwardFrontier) backwardMark[node] = 0;
+        }
+
+        void begin(size_t nodeCount) {
+            if (forwardMark.size() < nodeCount) {
+                forwardMark.resize(nodeCount, 0);
+                backwardMark.resize(nodeCount, 0);
+            }
+            if (++generation == 0) {
+                std::fill(forwardMark.begin(), forwardMark.end(), 0);
+                std::fill(backwardMark.begin(), backwardMark.end(), 0);
+                generation = 1;
+            }
+        }
+
+    public:
+        // Whether the last search, which found no cycle, could have followed an
+        // edge from -> to had it been there: it searched forward from `from` or
+        // backward from `to`. Edges for which this is false cannot change its outcome.
+        bool couldFollow(uint32_t from, uint32_t to) const {
+            return from == start || to == start || forwardMark[from] == generation || backwardMark[to] == generation;
+        }
+    };
+
+    // Extra edges for a search: none
+    struct NoExtraEdges {
+        template <typename Visit>
+        bool successors(uint32_t, Visit) const {
+            return false;
+        }
+
+        template <typename Visit>
+        bool predecessors(uint32_t, Visit) const {
+            return false;
+        }
+    };
+
+    // Extra edges for a search: one edge between existing nodes
+    struct ExtraEdge {
+        uint32_t from, to;
+
+        template <typename Visit>
+        bool successors(uint32_t node, Visit visit) const {
+            return node == from && visit(to);
+        }
+
+        template <typename Visit>
+        bool predecessors(uint32_t node, Visit visit) const {
+            return node == to && visit(from);
+        }
+    };
+
+    // Extra edges for a search: a list of edges between existing nodes, kept
+    // apart from the graph until merged into it
+    class EdgeOverlay {
+    private:
+        struct Edge {
+            uint32_t from, to;
+            uint32_t previousOut, previousIn;  // Index + 1 of the previous edge from `from` / to `to`, 0 if none
+        };
+
+        std::vector<Edge> edges;
+        std::vector<uint32_t> lastOut, lastIn;  // Per node: index + 1 of its newest edge, 0 if none
+
+    public:
+        void add(uint32_t from, uint32_t to) {
+            size_t nodes = std::max(from, to) + static_cast<size_t>(1);
+            if (lastOut.size() < nodes) {
+                lastOut.resize(nodes, 0);
+                lastIn.resize(nodes, 0);
+            }
+            edges.push_back({ from, to, lastOut[from], lastIn[to] });
+            lastOut[from] = lastIn[to] = static_cast<uint32_t>(edges.size());
+        }
+
+        void removeLast() {
+            const Edge& edge = edges.back();
+            lastOut[edge.from] = edge.previousOut;
+            lastIn[edge.to] = edge.previousIn;
+            edges.pop_back();
+        }
+
+        void clear() {
+            for (const Edge& edge : edges) lastOut[edge.from] = lastIn[edge.to] = 0;
+            edges.clear();
+        }
+
+        size_t size() const {
+            return edges.size();
+        }
+
+        uint32_t from(size_t index) const {
+            return edges[index].from;
+        }
+
+        uint32_t to(size_t index) const {
+            return edges[index].to;
+        }
+
+        template <typename Visit>
+        bool successors(uint32_t node, Visit visit) const {
+            for (uint32_t i = node < lastOut.size() ? lastOut[node] : 0; i; i = edges[i - 1].previousOut) {
+                if (visit(edges[i - 1].to)) return true;
+            }
+            return false;
+        }
+
+        template <typename Visit>
+        bool predecessors(uint32_t node, Visit visit) const {
+            for (uint32_t i = node < lastIn.size() ? lastIn[node] : 0; i; i = edges[i - 1].previousIn) {
+                if (visit(edges[i - 1].from)) return true;
+            }
+            return false;
+        }
+    };
+
+private:
+    struct TimedEdge {
+        uint32_t from, to;
+        long long timestamp;
+    };
+
+    FlatHashMap<uint32_t> nodeOf;                   // Account ID -> node index
+    std::vector<EdgeList> successors;
+    std::vector<EdgeList> predecessors;
+    std::deque<TimedEdge> edgeAges;                 // Oldest first, when tracking ages
+    bool trackingAges = false;
+    CycleSearch search;                             // Scratch for hasCycleThrough(accountID, maxLength)
+
+    uint32_t nodeFor(int accountID) {
+        uint32_t& index = nodeOf[static_cast<uint32_t>(accountID)];
+        if (index == 0) {
+            // Stored off by one so a fresh (zero) entry means "no node yet"
+            successors.emplace_back();
+            predecessors.emplace_back();
+            index = static_cast<uint32_t>(successors.size());
+        }
+        return index - 1;
+    }
+
+    static size_t countEdges(const std::vector<EdgeList>& lists) {
+        size_t count = 0;
+        for (const auto& list : lists) count += list.end() - list.begin();
+        return count;
+    }
+
+    // Adjacency lists are stored flattened: offsets[node]..offsets[node + 1] in targets
+    static void saveLists(SnapshotWriter& out, const std::vector<EdgeList>& lists) {
+        std::vector<uint64_t> offsets(1, 0);
+        std::vector<uint32_t> targets;
+        offsets.reserve(lists.size() + 1);
+        for (const auto& list : lists) {
+            targets.insert(targets.end(), list.begin(), list.end());
+            offsets.push_back(targets.size());
+        }
+        out.writeVector(offsets);
+        out.writeVector(targets);
+    }
+
+    static bool loadLists(SnapshotReader& in, std::vector<EdgeList>& lists) {
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> targets;
+        if (!in.readVector(offsets) || !in.readVector(targets) || offsets.empty() || offsets.back() != targets.size()) {
+            return false;
+        }
+        size_t nodeCount = offsets.size() - 1;
+        for (uint32_t target : targets) {
+            if (target >= nodeCount) return false;
+        }
+        lists.assign(nodeCount, {});
+        for (size_t node = 0; node < nodeCount; ++node) {
+            if (offsets[node] > offsets[node + 1] || offsets[node + 1] > targets.size()) return false;
+            lists[node].assign(targets.data() + offsets[node], targets.data() + offsets[node + 1]);
+        }
+        return true;
+    }
+
+public:
+    void save(SnapshotWriter& out) const {
+        nodeOf.save(out);
+        saveLists(out, successors);
+        saveLists(out, predecessors);
+        out.write(trackingAges);
+        std::vector<TimedEdge> ages(edgeAges.begin(), edgeAges.end());
+        out.writeVector(ages);
+    }
+
+    // Node indices must lie within the lists, and when tracking ages every
+    // edge must be queued in an order matching both lists, as expiry pops
+    // them from the fronts
+    bool load(SnapshotReader& in) {
+        std::vector<TimedEdge> ages;
+        uint8_t tracking = 0;
+        static_assert(sizeof(tracking) == sizeof(trackingAges), "flag is saved as one byte");
+        if (!nodeOf.load(in) || !loadLists(in, successors) || !loadLists(in, predecessors) ||
+            successors.size() != predecessors.size() || !in.read(tracking) || !in.readVector(ages) || tracking > 1 ||
+            nodeOf.size() != successors.size() || edgeCount() != countEdges(predecessors) ||
+            ages.size() != (tracking ? edgeCount() : 0)) {
+            return false;
+        }
+        size_t nodes = successors.size();
+        bool ok = true;
+        nodeOf.forEach([&](uint64_t, uint32_t entry) { ok = ok && entry >= 1 && entry <= nodes; });
+        std::vector<size_t> outCursor(nodes, 0), inCursor(nodes, 0);
+        for (const TimedEdge& edge : ages) {
+            if (!ok || edge.from >= nodes || edge.to >= nodes) return false;
+            const EdgeList& out = successors[edge.from];
+            const EdgeList& incoming = predecessors[edge.to];
+            size_t outIndex = outCursor[edge.from]++, inIndex = inCursor[edge.to]++;
+            ok = outIndex < static_cast<size_t>(out.end() - out.begin()) && out.begin()[outIndex] == edge.to &&
+                 inIndex < static_cast<size_t>(incoming.end() - incoming.begin()) && incoming.begin()[inIndex] == edge.from;
+        }
+        if (!ok) return false;
+        trackingAges = tracking != 0;
+        edgeAges.assign(ages.begin(), ages.end());
+        return true;
+    }
+
+    // timestamp: the transfer's time, used for expiry when tracking ages
+    void addEdge(int fromID, int toID, long long timestamp = 0) {
+        uint32_t from = nodeFor(fromID), to = nodeFor(toID);
+        successors[from].push_back(to);
+        predecessors[to].push_back(from);
+        if (trackingAges) edgeAges.push_back({ from, to, timestamp });
+    }
+
+    // Node index of an account, adding a node without edges if it has none
+    uint32_t addNode(int accountID) {
+        return nodeFor(accountID);
+    }
+
+    bool findNode(int accountID, uint32_t& node) const {
+        const uint32_t* entry = nodeOf.find(static_cast<uint32_t>(accountID));
+        if (!entry) return false;
+        node = *entry - 1;
+        return true;
+    }
+
+    // addEdge between existing nodes, for callers that track ages themselves or not at all
+    void addNodeEdge(uint32_t from, uint32_t to) {
+        successors[from].push_back(to);
+        predecessors[to].push_back(from);
+    }
+
+    // Undo the most recent addEdge(fromID, toID)
+    void removeLastEdge(int fromID, int toID) {
+        uint32_t from = *nodeOf.find(static_cast<uint32_t>(fromID)) - 1;
+        uint32_t to = *nodeOf.find(static_cast<uint32_t>(toID)) - 1;
+        successors[from].pop_back();
+        predecessors[to].pop_back();
+        if (trackingAges) edgeAges.pop_back();
+    }
+
+    // Start or stop queueing edges for expiry. Edges already in the graph when
+    // tracking starts keep their place: they are queued oldest first, each
+    // with existingTimestamp as their own is not known.
+    void trackAges(bool enabled, long long existingTimestamp) {
+        if (enabled && !trackingAges) queueExistingEdges(existingTimestamp);
+        if (!enabled) edgeAges.clear();
+        trackingAges = enabled;
+    }
+
+    // Queue every edge for expiry in an order that matches every list: an edge
+    // goes next once it is the first unqueued edge of both its successor and
+    // its predecessor list. The order edges were added in is one such order,
+    // so all of them get queued.
+    void queueExistingEdges(long long timestamp) {
+        edgeAges.clear();
+        std::vector<uint32_t> queuedOut(successors.size(), 0), queuedIn(predecessors.size(), 0);
+        std::vector<uint32_t> ready;  // Nodes whose first unqueued successor edge may go next
+        auto check = [&](uint32_t from) {
+            const EdgeList& out = successors[from];
+            if (out.begin() + queuedOut[from] == out.end()) return false;
+            uint32_t to = out.begin()[queuedOut[from]];
+            return predecessors[to].begin()[queuedIn[to]] == from;
+        };
+        for (uint32_t node = 0; node < successors.size(); ++node) {
+            if (check(node)) ready.push_back(node);
+        }
+        while (!ready.empty()) {
+            uint32_t from = ready.back();
+            ready.pop_back();
+            if (!check(from)) continue;  // Queued twice and already taken
+            uint32_t to = successors[from].begin()[queuedOut[from]++];
+            const EdgeList& in = predecessors[to];
+            edgeAges.push_back({ from, to, timestamp });
+            if (check(from)) ready.push_back(from);
+            if (in.begin() + ++queuedIn[to] != in.end() && check(in.begin()[queuedIn[to]])) {
+                ready.push_back(in.begin()[queuedIn[to]]);
+            }
+        }
+        if (edgeAges.size() != edgeCount()) {
+            std::cerr << "Transfer graph lists disagree on edge order; " << edgeCount() - edgeAges.size()
+                      << " edges will never expire." << std::endl;
+        }
+    }
+
+    // Expire edges older than cutoff, then the oldest beyond maxEdges. Edges
+    // leave every list in the order they joined it, so each expiring edge is
+    // at the front of both of its lists. Returns the number expired.
+    size_t expireEdges(long long cutoff, size_t maxEdges) {
+        size_t expired = 0;
+        while (!edgeAges.empty() && (edgeAges.front().timestamp < cutoff || edgeAges.size() > maxEdges)) {
+            const TimedEdge& edge = edgeAges.front();
+            successors[edge.from].popFront();
+            predecessors[edge.to].popFront();
+            edgeAges.pop_front();
+            ++expired;
+        }
+        return expired;
+    }
+
+    size_t edgeCount() const {
+        return countEdges(successors);
+    }
+
+    // True if some cycle of 2 to maxLength transfers passes through the account.
+    bool hasCycleThrough(int accountID, int maxLength) {
+        uint32_t start;
+        return findNode(accountID, start) && hasCycleThrough(start, maxLength, search, NoExtraEdges());
+    }
+
+    // True if some cycle of 2 to maxLength transfers passes through node start,
+    // in the graph plus the extra edges. Searches forward from the node's
+    // successors and backward from its predecessors, always widening the
+    // smaller frontier, until the two meet or their combined depth reaches
+    // maxLength.
+    template <typename Extra>
+    bool hasCycleThrough(uint32_t start, int maxLength, CycleSearch& search, const Extra& extra) const {
+        if (maxLength < 2) return false;
+        search.begin(successors.size());
+        search.start = start;
+        const uint32_t generation = search.generation;
+        std::vector<uint32_t>& forwardMark = search.forwardMark;
+        std::vector<uint32_t>& backwardMark = search.backwardMark;
+        std::vector<uint32_t>& nextFrontier = search.nextFrontier;
+        backwardMark[start] = generation;  // The start is never marked forward
+        search.forwardFrontier.assign(1, start);
+        search.backwardFrontier.assign(1, start);
+
+        for (int depth = 0; depth < maxLength && !search.forwardFrontier.empty() && !search.backwardFrontier.empty(); ++depth) {
+            nextFrontier.clear();
+            if (search.forwardFrontier.size() <= search.backwardFrontier.size()) {
+                for (uint32_t node : search.forwardFrontier) {
+                    auto visit = [&](uint32_t next) {
+                        if (next == start && node == start) return false;         // A self-transfer is not a cycle
+                        if (backwardMark[next] == generation) return true;         // Reaches the start within budget
+                        if (forwardMark[next] != generation) {
+                            forwardMark[next] = generation;
+                            nextFrontier.push_back(next);
+                        }
+                        return false;
+                    };
+                    for (uint32_t next : successors[node]) {
+                        if (visit(next)) return true;
+                    }
+                    if (extra.successors(node, visit)) return true;
+                }
+                search.forwardFrontier.swap(nextFrontier);
+            } else {
+                for (uint32_t node : search.backwardFrontier) {
+                    auto visit = [&](uint32_t prev) {
+                        if (prev == start) return node != start;                   // start -> node -> ... -> start, unless a self-transfer
+                        if (forwardMark[prev] == generation) return true;
+                        if (backwardMark[prev] != generation) {
+                            backwardMark[prev] = generation;
+                            nextFrontier.push_back(prev);
+                        }
+                        return false;
+                    };
+                    for (uint32_t prev : predecessors[node]) {
+                        if (visit(prev)) return true;
+                    }
+                    if (extra.predecessors(node, visit)) return true;
+                }
+                search.backwardFrontier.swap(nextFrontier);
+            }
+        }
+        search.unmarkFrontiers();
+        return false;
+    }
+};
+
+// Fixed set of worker threads for data-parallel loops. The calling thread works
+// alongside the pool, so a pool without threads simply runs loops inline.
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    const std::function<void(size_t)>* task = nullptr;
+    size_t taskSize = 0;
+    size_t chunkSize = 1;
+    std::atomic<size_t> nextIndex{0};
+    uint64_t jobID = 0;
+    size_t workersDone = 0;
+    bool stopping = false;
+
+    void runChunks() {
+        while (true) {
+            size_t begin = nextIndex.fetch_add(chunkSize);
+            if (begin >= taskSize) return;
+            size_t end = std::min(begin + chunkSize, taskSize);
+            for (size_t i = begin; i < end; ++i) (*task)(i);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t lastJob = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&]() { return stopping || jobID != lastJob; });
+            if (stopping) return;
+            lastJob = jobID;
+            lock.unlock();
+            runChunks();
+            lock.lock();
+            // Every worker checks in for every job, so the next job cannot start
+            // while one of them might still read this one's task
+            if (++workersDone == threads.size()) finished.notify_one();
+        }
+    }
+
+public:
+    explicit WorkerPool(unsigned numThreads) {
+        for (unsigned i = 0; i < numThreads; ++i) threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    // Threads taking part in a loop, including the caller
+    size_t concurrency() const {
+        return threads.size() + 1;
+    }
+
+    // Calls body(i) for every i in [0, count), spread over the pool; returns when all are done
+    void parallelFor(size_t count, const std::function<void(size_t)>& body) {
+        if (threads.empty() || count < 2) {
+            for (size_t i = 0; i < count; ++i) body(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &body;
+            taskSize = count;
+            chunkSize = std::max<size_t>(1, count / (concurrency() * 8));
+            nextIndex.store(0);
+            workersDone = 0;
+            ++jobID;
+        }
+        wake.notify_all();
+        runChunks();
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&]() { return workersDone == threads.size(); });
+        task = nullptr;
+    }
+};
+
+// How processing a transaction ended
+enum class TransactionStatus {
+    Accepted,
+    InvalidAccount,
+    InsufficientFunds,
+    FlaggedAccount,  // A party was flagged earlier
+    Fraud            // A detector fired; the sender is now flagged
+};
+
+struct TransactionResult {
+    TransactionStatus status;
+    std::string reason;  // Detector message when status is Fraud
+};
+
+const char* const VELOCITY_FRAUD_REASON = "Velocity fraud detected";
+const char* const FREQUENT_TRANSACTIONS_REASON = "Frequent large transactions to the same account";
+const char* const CIRCULAR_TRANSACTIONS_REASON = "Circular transactions detected";
+
+// Name of a status in machine-readable output
+const char* transactionStatusName(TransactionStatus status) {
+    switch (status) {
+        case TransactionStatus::Accepted: return "accepted";
+        case TransactionStatus::InvalidAccount: return "invalid_account";
+        case TransactionStatus::InsufficientFunds: return "insufficient_funds";
+        case TransactionStatus::FlaggedAccount: return "flagged_account";
+        case TransactionStatus::Fraud: return "fraud";
+    }
+    return "unknown";
+}
+
+// Alerts are the outcomes that involve a flagged or newly flagged account
+bool isAlert(TransactionStatus status) {
+    return status == TransactionStatus::FlaggedAccount || status == TransactionStatus::Fraud;
+}
+
+// Append a result in the console format of the interactive menu
+void appendTransactionResultText(std::string& out, std::string_view transactionID, int senderAccountID,
+                                 const TransactionResult& result) {
+    switch (result.status) {
+        case TransactionStatus::Accepted:
+            out.append("Transaction ID ").append(transactionID).append(" processed successfully.\n");
+            break;
+        case TransactionStatus::InvalidAccount:
+            out.append("Invalid account involved in transaction ID: ").append(transactionID).append("\n");
+            break;
+        case TransactionStatus::InsufficientFunds:
+            out.append("Insufficient funds for transaction ID: ").append(transactionID).append("\n");
+            break;
+        case TransactionStatus::FlaggedAccount:
+            out.append("Alert: Flagged account involved in transaction ID: ").append(transactionID)
+               .append(" (Reason: Flagged Account)\n");
+            break;
+        case TransactionStatus::Fraud:
+            out.append("Alert: Transaction ID ").append(transactionID).append(" failed. Reason: ") += result.reason + "\n";
+            out += "Account ID " + std::to_string(senderAccountID) + " has been flagged.\n";
+            break;
+    }
+}
+
+// Print a result in the console format of the interactive menu
+void printTransactionResult(const TransactionView& tx, const TransactionResult& result) {
+    std::string text;
+    appendTransactionResultText(text, tx.transactionID, tx.senderAccountID, result);
+    std::cout << text << std::flush;
+}
+
+// A result queued for output, holding only the fields the encoders use
+struct ResultRecord {
+    std::string transactionID;
+    int senderAccountID;
+    int receiverAccountID;
+    double amount;
+    long long timestamp;
+    TransactionResult result;
+};
+
+// Output back end of a ResultSink: serializes records into a byte buffer
+class ResultEncoder {
+public:
+    virtual ~ResultEncoder() = default;
+
+    // Bytes written once at the start of the output
+    virtual void appendHeader(std::string& out) const {
+        (void)out;
+    }
+
+    virtual void append(std::string& out, const ResultRecord& record) const = 0;
+};
+
+// The interactive console format
+class TextResultEncoder : public ResultEncoder {
+public:
+    void append(std::string& out, const ResultRecord& record) const override {
+        appendTransactionResultText(out, record.transactionID, record.senderAccountID, record.result);
+    }
+};
+
+// One JSON object per line
+class JsonLinesResultEncoder : public ResultEncoder {
+private:
+    static void appendString(std::string& out, const std::string& value) {
+        out += '"';
+        for (char c : value) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (byte < 0x20) {
+                const char* hex = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[byte >> 4];
+                out += hex[byte & 15];
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    template <typename T>
+    static void appendNumber(std::string& out, T value) {
+        char digits[32];
+        auto converted = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, converted.ptr);
+    }
+
+public:
+    void append(std::string& out, const ResultRecord& record) const override {
+        out += "{\"transactionID\":";
+        appendString(out, record.transactionID);
+        out += ",\"sender\":";
+        appendNumber(out, record.senderAccountID);
+        out += ",\"receiver\":";
+        appendNumber(out, record.receiverAccountID);
+        out += ",\"amount\":";
+        appendNumber(out, record.amount);
+        out += ",\"timestamp\":";
+        appendNumber(out, record.timestamp);
+        out += ",\"status\":\"";
+        out += transactionStatusName(record.result.status);
+        out += '"';
+        if (!record.result.reason.empty()) {
+            out += ",\"reason\":";
+            appendString(out, record.result.reason);
+        }
+        out += "}\n";
+    }
+};
+
+// Compact little-endian records after a "FDSR" + version byte header:
+// status u8, ID length u8, ID bytes, sender i32, receiver i32, amount f64,
+// timestamp i64, reason length u16, reason bytes
+class BinaryResultEncoder : public ResultEncoder {
+private:
+    template <typename T>
+    static void appendRaw(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+public:
+    void appendHeader(std::string& out) const override {
+        out.append("FDSR\x01", 5);
+    }
+
+    void append(std::string& out, const ResultRecord& record) const override {
+        size_t idLength = std::min<size_t>(record.transactionID.size(), std::numeric_limits<uint8_t>::max());
+        size_t reasonLength = std::min<size_t>(record.result.reason.size(), std::numeric_limits<uint16_t>::max());
+        appendRaw(out, static_cast<uint8_t>(record.result.status));
+        appendRaw(out, static_cast<uint8_t>(idLength));
+        out.append(record.transactionID.data(), idLength);
+        appendRaw(out, static_cast<int32_t>(record.senderAccountID));
+        appendRaw(out, static_cast<int32_t>(record.receiverAccountID));
+        appendRaw(out, record.amount);
+        appendRaw(out, static_cast<int64_t>(record.timestamp));
+        appendRaw(out, static_cast<uint16_t>(reasonLength));
+        out.append(record.result.reason.data(), reasonLength);
+    }
+};
+
+// Bounded lock-free multi-producer multi-consumer ring (Vyukov's design): each
+// cell carries a sequence number telling producers and consumers whose turn it is
+template <typename T>
+class LockFreeQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePosition{0};
+    alignas(64) std::atomic<size_t> dequeuePosition{0};
+
+public:
+    // capacity is rounded up to a power of two
+    explicit LockFreeQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Returns false when the queue is full
+    bool tryPush(T&& value) {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false when the queue is empty
+    bool tryPop(T& value) {
+        size_t position = dequeuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// Asynchronous result output. Producers queue records on a lock-free ring; a
+// background thread encodes them into a large buffer and writes it out in
+// blocks, so the processing threads never wait on the console or a file. When
+// the ring runs dry the writer parks on a condition variable, and only the
+// first record published after that wakes it. In alerts-only mode every other
+// outcome is dropped before it is queued.
+class ResultSink {
+private:
+    static const size_t WRITE_BLOCK = 1 << 16;
+    static const int IDLE_ROUNDS_BEFORE_PARKING = 64;
+
+    std::unique_ptr<ResultEncoder> encoder;
+    std::ostream& output;
+    bool alertsOnly;
+    LockFreeQueue<ResultRecord> queue;
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> writerParked{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::mutex drainMutex;
+    std::condition_variable drained;
+    std::thread writer;
+
+    void writerLoop() {
+        std::string buffer;
+        encoder->appendHeader(buffer);
+        ResultRecord record;
+        uint64_t count = 0;
+        int idleRounds = 0;
+        while (true) {
+            if (queue.tryPop(record)) {
+                encoder->append(buffer, record);
+                ++count;
+                idleRounds = 0;
+                if (buffer.size() >= WRITE_BLOCK) {
+                    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                    buffer.clear();
+                }
+                continue;
+            }
+
+            // Queue empty: push out what is buffered and let drain() callers go
+            if (!buffer.empty()) {
+                output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+                output.flush();
+            }
+            if (written.load(std::memory_order_relaxed) != count) {
+                std::lock_guard<std::mutex> lock(drainMutex);
+                written.store(count, std::memory_order_release);
+                drained.notify_all();
+            }
+            if (stopping.load(std::memory_order_acquire) && count == published.load(std::memory_order_acquire)) return;
+
+            // Yield a few rounds first: under a steady stream the next record is usually
+            // moments away, and parking for each one would cost a wakeup per record
+            if (++idleRounds < IDLE_ROUNDS_BEFORE_PARKING) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Nothing left to write: sleep until a record is published or the sink stops.
+            // The flag is raised before published is re-read and producers read it after
+            // counting their record, so one side always sees the other. It is raised
+            // again after every wakeup, since a producer that saw an earlier raise may
+            // have cleared it.
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            while (true) {
+                writerParked.store(true);
+                if (published.load() != count || stopping.load()) break;
+                wake.wait(lock);
+            }
+            writerParked.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void wakeWriter() {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+
+public:
+    // capacity: records queued before producers have to wait for the writer
+    ResultSink(std::unique_ptr<ResultEncoder> encoder, std::ostream& output, bool alertsOnly = false,
+               size_t capacity = 1 << 16)
+        : encoder(std::move(encoder)), output(output), alertsOnly(alertsOnly), queue(capacity) {
+        writer = std::thread(&ResultSink::writerLoop, this);
+    }
+
+    ~ResultSink() {
+        stopping.store(true, std::memory_order_release);
+        wakeWriter();
+        writer.join();
+    }
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    // Safe to call from several threads at once
+    void publish(const TransactionView& tx, const TransactionResult& result) {
+        if (alertsOnly && !isAlert(result.status)) return;
+        ResultRecord record{ std::string(tx.transactionID), tx.senderAccountID, tx.receiverAccountID, tx.amount, tx.timestamp, result };
+        while (!queue.tryPush(std::move(record))) std::this_thread::yield();
+        published.fetch_add(1);
+        // The writer is parked only once the queue is empty, so this signals the
+        // empty to non-empty transition; the exchange lets one producer do it
+        if (writerParked.load() && writerParked.exchange(false)) wakeWriter();
+    }
+
+    // Waits until everything published so far has been written and flushed
+    void drain() {
+        uint64_t target = published.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(drainMutex);
+        drained.wait(lock, [&]() { return written.load(std::memory_order_acquire) >= target; });
+    }
+};
+
+// Builds the sink for an output format name: "text", "jsonl" or "binary".
+// Returns nullptr for an unknown name.
+std::unique_ptr<ResultSink> makeResultSink(const std::string& format, std::ostream& output, bool alertsOnly) {
+    std::unique_ptr<ResultEncoder> encoder;
+    if (format == "text") encoder = std::make_unique<TextResultEncoder>();
+    else if (format == "jsonl") encoder = std::make_unique<JsonLinesResultEncoder>();
+    else if (format == "binary") encoder = std::make_unique<BinaryResultEncoder>();
+    else return nullptr;
+    return std::make_unique<ResultSink>(std::move(encoder), output, alertsOnly);
+}
+
+// How much transaction history to keep. The log, account histories, edge
+// statistics and transfer graph then cover only the retained transactions, so
+// every detector looks at that window; memory stays bounded under a steady load.
+// All limits are off by default, which keeps everything.
+struct RetentionPolicy {
+    long long maxAge = 0;        // Keep transactions this many seconds older than the newest at most
+    size_t maxTransactions = 0;  // Keep at most this many accepted transactions (and as many edges)
+    size_t memoryBudget = 0;     // Bytes for the retained transactions and edges
+    std::string archivePath;     // Append evicted transactions here, in the input format
+
+    bool enabled() const {
+        return maxAge > 0 || maxTransactions > 0 || memoryBudget > 0;
+    }
+};
+
+// What a fraud check sees: the transaction, its description verdict when
+// processBatch computed it ahead of time, and the account table indices of its
+// sender and receiver
+struct CheckInput {
+    const TransactionView& tx;
+    const DescriptionVerdict* precomputedDescription;
+    uint32_t sender, receiver;
+};
+
+// The fraud checks as a chain of pluggable stages. Checks are registered in
+// canonical order, the order whose first rejection decides the outcome, and
+// must not change what other checks see. They are evaluated in an adaptive order instead: each
+// check's cost (sampled) and rejection rate are tracked, and every
+// REORDER_INTERVAL transactions the order is re-sorted by cost per rejection,
+// which minimizes the expected cost of a short-circuiting chain. When a check
+// rejects, the canonically earlier checks not yet run are run too and the
+// first of them to reject wins, so the outcome and its reason never depend on
+// the evaluation order.
+class CheckPipeline {
+public:
+    using CheckFunction = std::function<TransactionResult(const CheckInput&)>;  // status Accepted to pass
+
+private:
+    struct Check {
+        std::string name;
+        CheckFunction run;
+        uint64_t evaluations = 0;
+        uint64_t rejections = 0;
+        uint64_t sampledTicks = 0;
+        uint64_t samples = 0;
+        double cost = 0;        // Mean ticks per evaluation, as of the last reordering
+        double rejectRate = 0;  // Likewise
+    };
+
+    static constexpr uint64_t REORDER_INTERVAL = 1 << 14;
+    static constexpr uint64_t SAMPLE_MASK = 255;  // Time one evaluation in 256
+
+    std::vector<Check> checks;    // Canonical order
+    std::vector<size_t> order;    // Evaluation order
+    enum Outcome : uint8_t { NotRun, Passed, Rejected };
+    std::vector<uint8_t> outcomes;  // Per check, for the transaction last run
+    bool adaptive = true;
+    uint64_t sinceReorder = 0;
+    uint64_t sampleCounter = 0;
+    StageClock clock;
+    bool calibrated = false;
+
+    TransactionResult evaluate(size_t index, const CheckInput& input) {
+        Check& check = checks[index];
+        ++check.evaluations;
+        TransactionResult result;
+        if ((sampleCounter++ & SAMPLE_MASK) == 0) {
+            uint64_t start = StageClock::ticks();
+            result = check.run(input);
+            check.sampledTicks += StageClock::ticks() - start;
+            ++check.samples;
+        } else {
+            result = check.run(input);
+        }
+        bool rejected = result.status != TransactionStatus::Accepted;
+        outcomes[index] = rejected ? Rejected : Passed;
+        check.rejections += rejected;
+        return result;
+    }
+
+    // Sort by cost per rejection, estimated from the counts since the last
+    // reordering (halved each time, so the order follows the workload)
+    void reorder() {
+        for (Check& check : checks) {
+            if (check.samples) check.cost = static_cast<double>(check.sampledTicks) / static_cast<double>(check.samples);
+            check.rejectRate = (check.rejections + 1.0) / (check.evaluations + 2.0);
+            check.evaluations /= 2;
+            check.rejections /= 2;
+            check.sampledTicks /= 2;
+            check.samples /= 2;
+        }
+        if (!adaptive) return;
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return checks[a].cost / checks[a].rejectRate < checks[b].cost / checks[b].rejectRate;
+        });
+    }
+
+public:
+    // Register a check after all existing ones in canonical order
+    void add(const std::string& name, CheckFunction run) {
+        checks.push_back({ name, std::move(run) });
+        order.push_back(checks.size() - 1);
+        outcomes.push_back(NotRun);
+    }
+
+    size_t size() const {
+        return checks.size();
+    }
+
+    // Whether the check ran and passed in the last run()
+    bool passed(size_t index) const {
+        return outcomes[index] == Passed;
+    }
+
+    // With adaptive off, checks run in canonical order
+    void setAdaptive(bool enabled) {
+        adaptive = enabled;
+        order.resize(checks.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    }
+
+    // Run the checks. Returns the rejecting check's canonical index, or -1
+    // with result set to Accepted if every check passed.
+    int run(const CheckInput& input, TransactionResult& result) {
+        std::fill(outcomes.begin(), outcomes.end(), NotRun);
+        int rejectedBy = -1;
+        for (size_t index : order) {
+            result = evaluate(index, input);
+            if (result.status != TransactionStatus::Accepted) {
+                rejectedBy = static_cast<int>(index);
+                break;
+            }
+        }
+        for (int index = 0; index < rejectedBy; ++index) {
+            if (outcomes[index] != NotRun) continue;
+            TransactionResult earlier = evaluate(index, input);
+            if (earlier.status != TransactionStatus::Accepted) {
+                result = std::move(earlier);
+                rejectedBy = index;
+                break;
+            }
+        }
+        if (rejectedBy < 0) result = { TransactionStatus::Accepted, "" };
+        if (++sinceReorder == REORDER_INTERVAL) {
+            sinceReorder = 0;
+            reorder();
+        }
+        return rejectedBy;
+    }
+
+    // The current evaluation order with the estimates behind it
+    void printReport(std::ostream& out = std::cout) {
+        if (!calibrated) {
+            clock.calibrate();
+            calibrated = true;
+        }
+        out << "Check order" << (adaptive ? " (adaptive)" : "") << ":";
+        for (size_t index : order) {
+            const Check& check = checks[index];
+            double cost = check.samples ? static_cast<double>(check.sampledTicks) / static_cast<double>(check.samples) : check.cost;
+            out << " " << check.name << " [" << clock.toNanoseconds(static_cast<uint64_t>(cost)) << " ns, "
+                << 100.0 * (check.evaluations ? static_cast<double>(check.rejections) / static_cast<double>(check.evaluations)
+                                              : check.rejectRate)
+                << "% rejected]";
+        }
+        out << std::endl;
+    }
+};
+
+// Fraud Detection System
+class FraudDetectionSystem {
+public:
+    BKTree bkTree;
+    PatternAutomaton patternAutomaton;
+    AccountTable accounts;
+    FlaggedAccountSet flaggedAccounts;
+    TransactionLog transactionLog;  // Every accepted transaction, indexed by ID
+    std::unordered_set<std::string> suspiciousPatterns;
+    EdgeStatsTable edgeStats;  // For frequent transactions
+    TransactionGraph transactionGraph;  // For circular transaction detection
+    static constexpr int MAX_CYCLE_LENGTH = 11;  // Longest cycle searched for, in transfers
+    VelocityTracker velocityTracker{ 60, 5 };  // 5 transactions within 60 seconds, by account index
+    DescriptionChecker descriptionChecker{ bkTree, patternAutomaton };
+    WorkerPool workerPool;
+    ResultSink* resultSink = nullptr;  // Where results go; printed directly when unset
+    WriteAheadLog* writeAheadLog = nullptr;  // Where state changes are logged; not logged when unset
+    CheckPipeline checks;  // The fraud checks after validation, in adaptive order
+    int cycleCheck = -1;   // Canonical index of the cycle check in checks
+    RetentionPolicy retention;
+    std::ofstream archive;                                        // Where evicted transactions go, if anywhere
+    long long newestTimestamp = std::numeric_limits<long long>::min();
+    size_t evictedTransactions = 0;
+    size_t expiredEdges = 0;
+    uint64_t transactionsApplied = 0;  // Transactions run through the checks, accepted or not
+    std::thread snapshotWriter;        // Background write of the last snapshot, if any
+    bool snapshotWritten = true;       // Outcome of that write, valid once it is joined
+
+    // workerThreads: helpers for processBatch besides the calling thread
+    FraudDetectionSystem(size_t expectedFlaggedAccounts = 100000, double bloomFalsePositiveRate = 0.01,
+                         unsigned workerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1)
+        : flaggedAccounts(expectedFlaggedAccounts, bloomFalsePositiveRate), workerPool(workerThreads) {
+        registerChecks();
+    }
+
+    // The built-in checks, in canonical order. applyTransaction makes the
+    // changes that follow from the outcome.
+    void registerChecks() {
+        // Check for flagged accounts
+        checks.add("flagged", [this](const CheckInput& in) -> TransactionResult {
+            StageTimer timer(Stage::Bloom);
+            if (isFlagged(in.tx.senderAccountID, in.tx.receiverAccountID)) {
+                timer.hit();
+                return { TransactionStatus::FlaggedAccount, "" };
+            }
+            return { TransactionStatus::Accepted, "" };
+        });
+
+        // Check the description for typosquatting and suspicious patterns
+        checks.add("description", [this](const CheckInput& in) -> TransactionResult {
+            DescriptionVerdict computed;
+            if (!in.precomputedDescription) {
+                validateVerdictCaches();
+                computed = checkDescription(in.tx.description);
+            }
+            const DescriptionVerdict& verdict = in.precomputedDescription ? *in.precomputedDescription : computed;
+            if (verdict.suspicious) return { TransactionStatus::Fraud, verdict.reason };
+            return { TransactionStatus::Accepted, "" };
+        });
+
+        // Velocity Fraud Detection
+        checks.add("velocity", [this](const CheckInput& in) -> TransactionResult {
+            StageTimer timer(Stage::Velocity);
+            if (velocityTracker.exceedsSlot(in.sender, in.tx.timestamp)) {
+                timer.hit();
+                return { TransactionStatus::Fraud, VELOCITY_FRAUD_REASON };
+            }
+            return { TransactionStatus::Accepted, "" };
+        });
+
+        // Frequent Transactions to Same Account
+        checks.add("frequency", [this](const CheckInput& in) -> TransactionResult {
+            StageTimer timer(Stage::Frequency);
+            if (detectFrequentTransactions(in.tx.senderAccountID, in.tx.receiverAccountID, in.tx.amount)) {
+                timer.hit();
+                return { TransactionStatus::Fraud, FREQUENT_TRANSACTIONS_REASON };
+            }
+            return { TransactionStatus::Accepted, "" };
+        });
+
+        // Circular Transactions Detection. The one check with an effect: it
+        // leaves the new edge in the graph unless the edge closes a cycle.
+        cycleCheck = static_cast<int>(checks.size());
+        checks.add("cycle", [this](const CheckInput& in) -> TransactionResult {
+            StageTimer timer(Stage::Cycle);
+            // Add the edge to the graph
+            transactionGraph.addEdge(in.tx.senderAccountID, in.tx.receiverAccountID, in.tx.timestamp);
+            if (detectCircularTransactions(in.tx.senderAccountID, in.tx.receiverAccountID)) {
+                // Remove the edge again
+                transactionGraph.removeLastEdge(in.tx.senderAccountID, in.tx.receiverAccountID);
+                timer.hit();
+                return { TransactionStatus::Fraud, CIRCULAR_TRANSACTIONS_REASON };
+            }
+            return { TransactionStatus::Accepted, "" };
+        });
+    }
+
+    ~FraudDetectionSystem() {
+        // Destructor to ensure all dynamically allocated memory is cleaned up
+        waitForSnapshot();
+    }
+
+    static uint64_t snapshotLayout() {
+        const uint64_t byteOrder = 0x0102030405060708ULL;
+        uint64_t layout = mix64(byteOrder);
+        for (uint64_t size : { sizeof(int), sizeof(long long), sizeof(double), sizeof(size_t), sizeof(TransactionRecord),
+                               sizeof(EdgeStats), sizeof(FlatHashMap<EdgeStats>), sizeof(FlatHashMap<uint32_t>) }) {
+            layout = mix64(layout ^ size);
+        }
+        return layout;
+    }
+
+    // Save the full system state to path. The state is serialized into memory
+    // before returning, so processing can resume at once; with background set,
+    // the write to disk continues on its own thread (see waitForSnapshot).
+    bool saveSnapshot(const std::string& path, bool background = true) {
+        if (!waitForSnapshot()) {
+            std::cerr << "Previous snapshot was not written." << std::endl;
+        }
+        std::string image = snapshotImage();
+        if (!background) {
+            return writeFileDurably(path, image);
+        }
+        snapshotWriter = std::thread([this, path, image = std::move(image)]() {
+            snapshotWritten = writeFileDurably(path, image);
+        });
+        return true;
+    }
+
+    // The full system state as a snapshot file image, header included
+    std::string snapshotImage() const {
+        SnapshotWriter out;
+        out.write(SnapshotHeader{});
+
+        accounts.save(out, transactionLog.beginIndex());
+        out.write<uint64_t>(suspiciousPatterns.size());
+        for (const auto& pattern : suspiciousPatterns) out.writeString(pattern);
+        bkTree.save(out);
+        patternAutomaton.save(out);
+        flaggedAccounts.save(out);
+        transactionLog.save(out);
+        edgeStats.save(out);
+        transactionGraph.save(out);
+        velocityTracker.save(out);
+
+        std::string& image = out.image();
+        SnapshotHeader header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.layout = snapshotLayout();
+        header.sequence = transactionsApplied;
+        header.payloadLength = image.size() - sizeof(SnapshotHeader);
+        header.checksum = checksum64(image.data() + sizeof(SnapshotHeader), header.payloadLength);
+        std::memcpy(&image[0], &header, sizeof(header));
+        return std::move(image);
+    }
+
+    // Wait for a background snapshot write; false if it failed
+    bool waitForSnapshot() {
+        if (snapshotWriter.joinable()) snapshotWriter.join();
+        bool written = snapshotWritten;
+        snapshotWritten = true;
+        return written;
+    }
+
+    // Replace the system state with a snapshot. The file is mapped and its
+    // header and checksum verified before anything changes; arrays then load by
+    // straight copies out of the mapping, including the account index, so only
+    // the hash indexes over interned strings and flags are rebuilt.
+    bool loadSnapshot(const std::string& path) {
+        MappedFile file(path);
+        if (!file.isOpen()) {
+            std::cerr << "Error opening snapshot: " << path << std::endl;
+            return false;
+        }
+        return loadSnapshotImage(file.contents(), path);
+    }
+
+    // loadSnapshot on an image already in memory; path names it in messages.
+    // The checksum only catches accidents, so every index between tables is
+    // checked too: a failed load leaves the state incomplete but never reads
+    // out of bounds later.
+    bool loadSnapshotImage(std::string_view contents, const std::string& path) {
+        SnapshotHeader header;
+        if (contents.size() < sizeof(header)) {
+            std::cerr << "Not a snapshot file: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(&header, contents.data(), sizeof(header));
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+            std::cerr << "Not a snapshot file: " << path << std::endl;
+            return false;
+        }
+        if (header.version != SNAPSHOT_VERSION || header.layout != snapshotLayout()) {
+            std::cerr << "Snapshot " << path << " was written by an incompatible version (format "
+                      << header.version << ")." << std::endl;
+            return false;
+        }
+        std::string_view payload = contents.substr(sizeof(header));
+        if (payload.size() != header.payloadLength || checksum64(payload.data(), payload.size()) != header.checksum) {
+            std::cerr << "Snapshot " << path << " is truncated or corrupt." << std::endl;
+            return false;
+        }
+
+        SnapshotReader in(payload);
+        bool ok = accounts.load(in);
+        uint64_t patternCount = 0;
+        ok = ok && in.readCount(patternCount, sizeof(uint64_t));
+        suspiciousPatterns.clear();
+        std::string pattern;
+        for (uint64_t i = 0; ok && i < patternCount; ++i) {
+            ok = in.readString(pattern);
+            if (ok) suspiciousPatterns.insert(pattern);
+        }
+        ok = ok && bkTree.load(in) && patternAutomaton.load(in) && flaggedAccounts.load(in) &&
+             transactionLog.load(in) && edgeStats.load(in) && transactionGraph.load(in) && velocityTracker.load(in);
+        ok = ok && accounts.historiesWithin(transactionLog.beginIndex(), transactionLog.endIndex());
+        if (!ok) {
+            // Reachable with a snapshot from a mismatched build, or one altered and given a fresh checksum
+            std::cerr << "Snapshot " << path << " is inconsistent; system state is incomplete." << std::endl;
+            return false;
+        }
+        transactionsApplied = header.sequence;
+        validateVerdictCaches();
+        return true;
+    }
+
+    void addAccount(int accountID, double initialBalance) {
+        if (accounts.add(accountID, initialBalance) == AccountTable::NONE) {
+            std::cout << "Account ID " << accountID << " already exists." << std::endl;
+            return;
+        }
+        std::cout << "Account ID " << accountID << " added with initial balance $" << initialBalance << "." << std::endl;
+    }
+
+    void bulkAddAccounts(int startID, int endID, double initialBalance, bool verbose = true) {
+        if (endID >= startID) {
+            accounts.reserve(accounts.size() + (endID - startID + 1));
+            velocityTracker.reserveSlots(accounts.size() + (endID - startID + 1));
+        }
+        for (int i = startID; i <= endID; ++i) {
+            if (accounts.add(i, initialBalance) != AccountTable::NONE) {
+                if (verbose) std::cout << "Account ID " << i << " added with initial balance $" << initialBalance << "." << std::endl;
+            } else if (verbose) {
+                std::cout << "Account ID " << i << " already exists. Skipping." << std::endl;
+            }
+        }
+        if (verbose) std::cout << "Bulk account addition completed." << std::endl;
+    }
+
+    TransactionResult processTransaction(const TransactionView& tx) {
+        return processTransaction(tx, nullptr);
+    }
+
+    // Process transactions in order. The description checks depend only on the
+    // description, so each chunk has them computed on the worker pool first; the
+    // stateful checks and balance updates then run sequentially, giving exactly
+    // the results of calling processTransaction on each transaction in turn.
+    // Takes Transactions or TransactionViews; neither is copied.
+    template <typename Record>
+    std::vector<TransactionResult> processBatch(const std::vector<Record>& batch, bool printResults = true) {
+        const size_t CHUNK = 1 << 14;
+        std::vector<TransactionResult> results;
+        results.reserve(batch.size());
+        std::vector<DescriptionVerdict> verdicts;
+        validateVerdictCaches();
+        for (size_t base = 0; base < batch.size(); base += CHUNK) {
+            size_t count = std::min(CHUNK, batch.size() - base);
+            verdicts.assign(count, DescriptionVerdict{});
+            workerPool.parallelFor(count, [&](size_t i) {
+                verdicts[i] = checkDescription(batch[base + i].description);
+            });
+            for (size_t i = 0; i < count; ++i) {
+                results.push_back(applyTransaction(batch[base + i], &verdicts[i]));
+            }
+            // Results are only reported once the changes behind them are durable
+            if (writeAheadLog && writeAheadLog->commitsPerBatch()) writeAheadLog->commit();
+            if (printResults) {
+                for (size_t i = 0; i < count; ++i) reportResult(batch[base + i], results[results.size() - count + i]);
+            }
+            StageProfiler::instance().poll(std::cerr);
+        }
+        return results;
+    }
+
+    // precomputed: the transaction's description verdict, or nullptr to check it here
+    TransactionResult processTransaction(const TransactionView& tx, const DescriptionVerdict* precomputed) {
+        TransactionResult result = applyTransaction(tx, precomputed);
+        if (writeAheadLog && writeAheadLog->commitsPerBatch()) writeAheadLog->commit();
+        reportResult(tx, result);
+        return result;
+    }
+
+    void reportResult(const TransactionView& tx, const TransactionResult& result) {
+        if (resultSink) {
+            resultSink->publish(tx, result);
+        } else {
+            printTransactionResult(tx, result);
+        }
+    }
+
+    // Run every check and, if the transaction passes, commit it. Prints nothing.
+    TransactionResult applyTransaction(const TransactionView& tx, const DescriptionVerdict* precomputed) {
+        ++transactionsApplied;
+        uint32_t sender, receiver;
+        {
+            StageTimer timer(Stage::Validation);
+            // Check if sender and receiver exist; every later step uses these indices
+            sender = accounts.find(tx.senderAccountID);
+            receiver = accounts.find(tx.receiverAccountID);
+            if (sender == AccountTable::NONE || receiver == AccountTable::NONE) {
+                timer.hit();
+                return { TransactionStatus::InvalidAccount, "" };
+            }
+
+            // Check if sender has enough balance
+            if (accounts.balance(sender) < tx.amount) {
+                timer.hit();
+                return { TransactionStatus::InsufficientFunds, "" };
+            }
+        }
+
+        TransactionResult result;
+        int rejectedBy = checks.run({ tx, precomputed, sender, receiver }, result);
+        if (result.status == TransactionStatus::FlaggedAccount) {
+            // Stopped before the cycle check in canonical order, so no edge either
+            if (checks.passed(cycleCheck)) transactionGraph.removeLastEdge(tx.senderAccountID, tx.receiverAccountID);
+            return result;  // Transaction fails
+        }
+
+        // The transfer's edge stays in the graph unless it closed a cycle. The
+        // cycle check left it there if it ran and passed; add it if not.
+        bool edgeKept = rejectedBy != cycleCheck;
+        if (edgeKept && !checks.passed(cycleCheck)) {
+            transactionGraph.addEdge(tx.senderAccountID, tx.receiverAccountID, tx.timestamp);
+        }
+
+        if (rejectedBy >= 0) {
+            // Flag the account
+            flaggedAccounts.insert(tx.senderAccountID);
+            if (writeAheadLog) {
+                writeAheadLog->appendFlag(transactionsApplied, tx.senderAccountID, tx.receiverAccountID, tx.timestamp,
+                                          edgeKept);
+            }
+            enforceRetention(tx.timestamp);
+            return result;  // Transaction fails
+        }
+
+        // Process the transaction
+        StageTimer timer(Stage::Commit);
+        timer.hit();
+        commitTransaction(tx, sender, receiver);
+        if (writeAheadLog) writeAheadLog->appendAccepted(transactionsApplied, tx);
+        enforceRetention(tx.timestamp);
+        return { TransactionStatus::Accepted, "" };
+    }
+
+    // Apply an accepted transaction's effects, after its edge went into the
+    // graph; sender and receiver are the accounts' table indices
+    void commitTransaction(const TransactionView& tx, uint32_t sender, uint32_t receiver) {
+        accounts.balance(sender) -= tx.amount;
+        accounts.balance(receiver) += tx.amount;
+
+        // Add transaction to the log and both histories
+        uint32_t logIndex = transactionLog.append(tx);
+        accounts.history(sender).push_back(logIndex);
+        accounts.history(receiver).push_back(logIndex);
+        velocityTracker.recordSlot(sender, tx.timestamp);
+        velocityTracker.recordSlot(receiver, tx.timestamp);
+
+        // Update transaction counts and amounts
+        edgeStats.record(tx.senderAccountID, tx.receiverAccountID, tx.amount, tx.timestamp);
+    }
+
+    // Approximate resident bytes per retained transaction: its log record, two
+    // history entries, its edge in both adjacency lists and its expiry entry
+    static size_t bytesPerRetainedTransaction() {
+        return sizeof(TransactionRecord) + 4 * sizeof(uint32_t) + 2 * sizeof(uint32_t) + 2 * sizeof(long long);
+    }
+
+    bool setRetentionPolicy(const RetentionPolicy& policy) {
+        if (archive.is_open()) archive.close();
+        if (!policy.archivePath.empty()) {
+            archive.open(policy.archivePath, std::ios::binary | std::ios::app);
+            if (!archive) {
+                std::cerr << "Error opening file for writing: " << policy.archivePath << std::endl;
+                return false;
+            }
+        }
+        retention = policy;
+        // Edges already in the graph, say from a snapshot, count as being as
+        // recent as the newest transaction known
+        long long existingTimestamp = newestTimestamp;
+        if (!transactionLog.empty()) {
+            existingTimestamp = std::max(existingTimestamp, transactionLog[transactionLog.endIndex() - 1].timestamp);
+        }
+        transactionGraph.trackAges(policy.enabled(), existingTimestamp);
+        return true;
+    }
+
+    // Evict what falls outside the retention policy now that a transaction at
+    // timestamp has been applied. Transactions leave in log order, so this does
+    // a constant amount of work per transaction on average.
+    void enforceRetention(long long timestamp) {
+        if (!retention.enabled()) return;
+        newestTimestamp = std::max(newestTimestamp, timestamp);
+        long long cutoff = retention.maxAge > 0 ? newestTimestamp - retention.maxAge : std::numeric_limits<long long>::min();
+        size_t limit = std::numeric_limits<size_t>::max();
+        if (retention.maxTransactions > 0) limit = retention.maxTransactions;
+        if (retention.memoryBudget > 0) limit = std::min(limit, retention.memoryBudget / bytesPerRetainedTransaction());
+
+        while (!transactionLog.empty() && (transactionLog.oldest().timestamp < cutoff || transactionLog.size() > limit)) {
+            const TransactionRecord& record = transactionLog.oldest();
+            if (archive.is_open()) {
+                Transaction tx = transactionLog.materialize(record);
+                char amount[32];
+                auto written = std::to_chars(amount, amount + sizeof(amount), tx.amount);
+                archive << tx.transactionID << ',' << tx.senderAccountID << ',' << tx.receiverAccountID << ','
+                        << std::string_view(amount, written.ptr - amount) << ',' << tx.timestamp << ','
+                        << tx.description << '\n';
+            }
+            edgeStats.forget(record.senderAccountID, record.receiverAccountID, record.amount);
+            int senderID = record.senderAccountID, receiverID = record.receiverAccountID;
+            transactionLog.evictOldest();
+            trimHistory(senderID);
+            trimHistory(receiverID);
+            ++evictedTransactions;
+        }
+        expiredEdges += transactionGraph.expireEdges(cutoff, limit);
+    }
+
+    // Drop history entries the log no longer holds once they are half the
+    // history; they are always at the front
+    void trimHistory(int accountID) {
+        uint32_t index = accounts.find(accountID);
+        if (index == AccountTable::NONE) return;
+        std::vector<uint32_t>& history = accounts.history(index);
+        size_t stale = std::lower_bound(history.begin(), history.end(), transactionLog.beginIndex()) - history.begin();
+        if (stale > 0 && stale * 2 >= history.size()) history.erase(history.begin(), history.begin() + stale);
+    }
+
+    // Replay the write-ahead log at path on top of the current state, normally
+    // just loaded from a snapshot; records the snapshot already covers are
+    // skipped. Rejections that changed nothing were never logged, so the
+    // transaction count resumes from the last logged change. Account creation
+    // is not logged, so every logged change must name accounts that already
+    // exist; recovery fails at the first that does not, as the log then belongs
+    // to a different account set.
+    bool recoverFromLog(const std::string& path, uint64_t& validLength, size_t& replayed) {
+        replayed = 0;
+        return WriteAheadLog::recover(path, [&](const LogRecord& record) {
+            if (record.sequence <= transactionsApplied) return true;
+            const Transaction& tx = record.tx;
+            uint32_t sender = accounts.find(tx.senderAccountID), receiver = accounts.find(tx.receiverAccountID);
+            if (sender == AccountTable::NONE || receiver == AccountTable::NONE) {
+                std::cerr << "Write-ahead log names account "
+                          << (sender == AccountTable::NONE ? tx.senderAccountID : tx.receiverAccountID)
+                          << ", which does not exist." << std::endl;
+                return false;
+            }
+            transactionsApplied = record.sequence;
+            ++replayed;
+            // Both kinds of change went through the cycle check, which put the edge in the graph
+            if (record.type == LogRecord::Type::Accepted) {
+                transactionGraph.addEdge(tx.senderAccountID, tx.receiverAccountID, tx.timestamp);
+                commitTransaction(tx, sender, receiver);
+            } else {
+                if (record.edgeKept) transactionGraph.addEdge(tx.senderAccountID, tx.receiverAccountID, tx.timestamp);
+                flaggedAccounts.insert(tx.senderAccountID);
+            }
+            enforceRetention(tx.timestamp);
+            return true;
+        }, validLength);
+    }
+
+    bool isFlagged(int senderID, int receiverID) const {
+        return flaggedAccounts.containsEither(senderID, receiverID);
+    }
+
+    void validateVerdictCaches() {
+        descriptionChecker.validate();
+    }
+
+    DescriptionVerdict checkDescription(std::string_view description) {
+        return descriptionChecker.check(description);
+    }
+
+    void printCacheStatistics(std::ostream& out = std::cout) const {
+        descriptionChecker.printStatistics(out);
+    }
+
+    void printRetentionStatistics(std::ostream& out = std::cout) const {
+        if (!retention.enabled()) return;
+        out << "Retention: " << transactionLog.size() << " transactions and " << transactionGraph.edgeCount()
+            << " edges kept, " << evictedTransactions << " transactions and " << expiredEdges << " edges evicted"
+            << (archive.is_open() ? " to " + retention.archivePath : "") << "." << std::endl;
+    }
+
+    // Velocity Fraud Detection
+    bool detectVelocityFraud(int accountID, long long currentTimestamp) {
+        uint32_t index = accounts.find(accountID);
+        return index != AccountTable::NONE && velocityTracker.exceedsSlot(index, currentTimestamp);
+    }
+
+    // Velocity limits: an account whose last maxTransactions transactions all fall
+    // within timeWindow seconds cannot transact again until the window moves on
+    void setVelocityLimits(long long timeWindow, int maxTransactions) {
+        velocityTracker.configure(timeWindow, maxTransactions);
+    }
+
+    // Frequent Transactions to the Same Account
+    bool detectFrequentTransactions(int senderID, int receiverID, double amount) {
+        return edgeStats.exceedsFrequencyLimit(senderID, receiverID, amount);
+    }
+
+    // Circular Transactions Detection
+    // The sender's new edge is already in the graph. Any short cycle through the
+    // sender counts, not only one closed by this edge: edges of transactions
+    // rejected by the earlier checks stay in the graph.
+    bool detectCircularTransactions(int senderID, int receiverID) {
+        (void)receiverID;
+        return transactionGraph.hasCycleThrough(senderID, MAX_CYCLE_LENGTH);
+    }
+
+    // Function to retrieve a transaction by ID
+    std::optional<Transaction> getTransaction(const std::string& transactionID) const {
+        if (const TransactionRecord* record = transactionLog.find(transactionID)) {
+            return transactionLog.materialize(*record);
+        }
+        return std::nullopt;
+    }
+
+    // Function to print account balance
+    void printAccountBalance(int accountID) {
+        uint32_t index = accounts.find(accountID);
+        if (index != AccountTable::NONE) {
+            std::cout << "Account ID: " << accountID << ", Balance: $" << accounts.balance(index) << std::endl;
+        } else {
+            std::cout << "Account ID: " << accountID << " does not exist." << std::endl;
+        }
+    }
+
+    // Function to load suspicious patterns
+    void addSuspiciousPattern(const std::string& pattern) {
+        suspiciousPatterns.insert(pattern);
+        patternAutomaton.build(suspiciousPatterns);
+    }
+
+    // Function to display all accounts
+    void displayAllAccounts() {
+        if (accounts.empty()) {
+            std::cout << "No accounts available." << std::endl;
+            return;
+        }
+        std::cout << "List of Accounts:" << std::endl;
+        for (uint32_t i = 0; i < accounts.size(); ++i) {
+            std::cout << "Account ID: " << accounts.id(i) << ", Balance: $" << accounts.balance(i) << std::endl;
+        }
+    }
+
+    // Function to display all transactions
+    void displayAllTransactions() {
+        if (transactionLog.empty()) {
+            std::cout << "No transactions available." << std::endl;
+            return;
+        }
+        std::cout << "List of Transactions:" << std::endl;
+        for (uint32_t i = transactionLog.beginIndex(); i < transactionLog.endIndex(); ++i) {
+            if (!transactionLog.isLatest(i)) continue;  // Superseded by a later transaction with the same ID
+            Transaction tx = transactionLog.materialize(transactionLog[i]);
+            std::cout << "Transaction ID: " << tx.transactionID
+                      << ", Sender: " << tx.senderAccountID
+                      << ", Receiver: " << tx.receiverAccountID
+                      << ", Amount: $" << tx.amount
+                      << ", Timestamp: " << tx.timestamp
+                      << ", Description: " << tx.description << std::endl;
+        }
+    }
+};
+
+// Account-sharded fraud engine. Accounts are hash-partitioned across shards, each
+// run by its own thread, which alone touches the shard's balances, flags, velocity
+// rings and the edge statistics of transfers sent from its accounts.
+// A transaction is decided by its sender's shard. When the receiver lives in
+// another shard, the two threads meet in a per-transaction slot: the receiver's
+// shard publishes what the checks need to know about the receiver, then waits
+// for the decision and credits the receiver if the transfer went through.
+// Only the transfer graph is shared. The batch is cut into epochs of
+// EPOCH_SIZE transactions, and every cycle search runs in parallel against the
+// graph as it stood when its epoch began, plus the transfer's own edge. The
+// edges an epoch adds wait in an overlay until it ends. At its turn, taken in
+// input order, a transaction checks the overlay: a cycle found in the older
+// graph is still there, and no cycle found stands unless the search could have
+// followed an overlay edge. Only then is the search re-run, over the graph
+// plus the overlay. Every shard works through its transactions in input order
+// as well, so the results match FraudDetectionSystem::processBatch on the same
+// input exactly.
+class ShardedFraudEngine {
+private:
+    struct Shard {
+        FlatHashMap<double> balances;  // Account ID -> balance, for accounts in this shard
+        FlaggedAccountSet flaggedAccounts;
+        VelocityTracker velocityTracker;
+        EdgeStatsTable edgeStats;      // Pairs whose sender is in this shard
+        std::vector<uint32_t> work;    // Batch indices of transactions touching this shard
+        TransactionGraph::CycleSearch cycleSearch;
+
+        Shard(size_t expectedFlaggedAccounts, double falsePositiveRate, long long timeWindow, int maxTransactions)
+            : flaggedAccounts(expectedFlaggedAccounts, falsePositiveRate), velocityTracker(timeWindow, maxTransactions) {}
+    };
+
+    // Hand-off between the sender's and receiver's shards for one transaction
+    struct TransferSlot {
+        std::atomic<uint8_t> receiverState{0};
+        std::atomic<uint8_t> decision{0};
+        std::atomic<uint8_t> graphDone{0};
+    };
+
+    static constexpr uint8_t RECEIVER_READY = 1, RECEIVER_EXISTS = 2, RECEIVER_FLAGGED = 4;
+    static constexpr uint8_t DECISION_ACCEPTED = 1, DECISION_REJECTED = 2;
+
+    static constexpr size_t EPOCH_SIZE = 128;  // Transactions whose cycle searches share one graph state
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    DescriptionChecker descriptionChecker;
+    TransactionGraph transactionGraph;          // As of the start of the current epoch
+    TransactionGraph::EdgeOverlay epochEdges;   // Edges added since, in input order
+    std::atomic<uint64_t> searchesAhead{0};     // Cycle searches run before their turn
+    std::atomic<uint64_t> searchesRerun{0};     // Those repeated at their turn over the epoch's edges
+
+    // State of the batch in progress
+    const std::vector<TransactionView>* batch = nullptr;
+    std::unique_ptr<TransferSlot[]> slots;
+    std::vector<TransactionResult> results;
+    std::atomic<size_t> graphWatermark{0};  // Every transaction below this is done with the graph
+    std::atomic<size_t> epochsReady{0};     // Epochs whose searches may start
+
+    static uint64_t accountKey(int accountID) {
+        return static_cast<uint32_t>(accountID);
+    }
+
+    size_t shardOf(int accountID) const {
+        return mix64(accountKey(accountID)) % shards.size();
+    }
+
+    static void waitUntil(const std::atomic<uint8_t>& flag, uint8_t& value) {
+        while ((value = flag.load(std::memory_order_acquire)) == 0) std::this_thread::yield();
+    }
+
+    // Block until transactions of the given epoch may search the graph
+    void waitForEpoch(size_t epoch) {
+        while (epochsReady.load(std::memory_order_acquire) <= epoch) std::this_thread::yield();
+    }
+
+    // Add graph nodes for the accounts of the epoch starting at first, so its
+    // searches and overlay edges never add one
+    void prepareEpoch(size_t first) {
+        size_t last = std::min(batch->size(), first + EPOCH_SIZE);
+        for (size_t i = first; i < last; ++i) {
+            transactionGraph.addNode((*batch)[i].senderAccountID);
+            transactionGraph.addNode((*batch)[i].receiverAccountID);
+        }
+    }
+
+    // Called in the turn of an epoch's last transaction, when every search of
+    // the epoch is done: merge its edges into the graph and open the next epoch
+    void finishEpoch(size_t lastIndex) {
+        for (size_t i = 0; i < epochEdges.size(); ++i) transactionGraph.addNodeEdge(epochEdges.from(i), epochEdges.to(i));
+        epochEdges.clear();
+        prepareEpoch(lastIndex + 1);
+        epochsReady.store(lastIndex / EPOCH_SIZE + 2, std::memory_order_release);
+    }
+
+    // Whether a search that found no cycle could have followed an edge added
+    // this epoch, so its outcome may differ with those edges present
+    bool mayMissEpochEdge(const TransactionGraph::CycleSearch& search) const {
+        for (size_t i = 0; i < epochEdges.size(); ++i) {
+            if (search.couldFollow(epochEdges.from(i), epochEdges.to(i))) return true;
+        }
+        return false;
+    }
+
+    // Block until every earlier transaction of the batch has finished with the graph
+    void waitForGraphTurn(size_t index) {
+        while (true) {
+            size_t mark = graphWatermark.load(std::memory_order_acquire);
+            if (mark >= index) return;
+            if (slots[mark].graphDone.load(std::memory_order_acquire)) {
+                graphWatermark.compare_exchange_weak(mark, mark + 1, std::memory_order_acq_rel);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Receiver side of a cross-shard transfer
+    void serveReceiver(Shard& shard, uint32_t index, const TransactionView& tx) {
+        TransferSlot& slot = slots[index];
+        double* balance = shard.balances.find(accountKey(tx.receiverAccountID));
+        uint8_t state = RECEIVER_READY;
+        if (balance) state |= RECEIVER_EXISTS;
+        if (shard.flaggedAccounts.contains(tx.receiverAccountID)) state |= RECEIVER_FLAGGED;
+        slot.receiverState.store(state, std::memory_order_release);
+
+        uint8_t decision;
+        waitUntil(slot.decision, decision);
+        if (decision == DECISION_ACCEPTED) {
+            *balance += tx.amount;
+            shard.velocityTracker.record(tx.receiverAccountID, tx.timestamp);
+        }
+    }
+
+    // Sender side: the same checks, in the same order, as FraudDetectionSystem::applyTransaction
+    void decide(Shard& shard, uint32_t index, const TransactionView& tx, bool receiverLocal) {
+        TransferSlot& slot = slots[index];
+        double* senderBalance = shard.balances.find(accountKey(tx.senderAccountID));
+        double* receiverBalance = nullptr;
+        bool receiverExists, receiverFlagged;
+        if (receiverLocal) {
+            receiverBalance = shard.balances.find(accountKey(tx.receiverAccountID));
+            receiverExists = receiverBalance != nullptr;
+            receiverFlagged = shard.flaggedAccounts.contains(tx.receiverAccountID);
+        } else {
+            uint8_t state;
+            waitUntil(slot.receiverState, state);
+            receiverExists = state & RECEIVER_EXISTS;
+            receiverFlagged = state & RECEIVER_FLAGGED;
+        }
+
+        TransactionResult result{ TransactionStatus::Accepted, "" };
+        if (!senderBalance || !receiverExists) {
+            result.status = TransactionStatus::InvalidAccount;
+        } else if (*senderBalance < tx.amount) {
+            result.status = TransactionStatus::InsufficientFunds;
+        } else if (shard.flaggedAccounts.contains(tx.senderAccountID) || receiverFlagged) {
+            result.status = TransactionStatus::FlaggedAccount;
+        } else {
+            DescriptionVerdict verdict = descriptionChecker.check(tx.description);
+            bool isFraudulent = verdict.suspicious;
+            std::string fraudReason = verdict.reason;
+            if (!isFraudulent && shard.velocityTracker.exceeds(tx.senderAccountID, tx.timestamp)) {
+                isFraudulent = true;
+                fraudReason = VELOCITY_FRAUD_REASON;
+            }
+            if (!isFraudulent && shard.edgeStats.exceedsFrequencyLimit(tx.senderAccountID, tx.receiverAccountID, tx.amount)) {
+                isFraudulent = true;
+                fraudReason = FREQUENT_TRANSACTIONS_REASON;
+            }
+
+            // Search the epoch's graph plus this edge ahead of the turn
+            uint32_t from = 0, to = 0;
+            bool cycle = false;
+            if (!isFraudulent) {
+                waitForEpoch(index / EPOCH_SIZE);
+                transactionGraph.findNode(tx.senderAccountID, from);
+                transactionGraph.findNode(tx.receiverAccountID, to);
+                cycle = transactionGraph.hasCycleThrough(from, FraudDetectionSystem::MAX_CYCLE_LENGTH, shard.cycleSearch,
+                                                         TransactionGraph::ExtraEdge{ from, to });
+                searchesAhead.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            waitForGraphTurn(index);
+            if (isFraudulent) {
+                transactionGraph.findNode(tx.senderAccountID, from);
+                transactionGraph.findNode(tx.receiverAccountID, to);
+            } else if (!cycle && mayMissEpochEdge(shard.cycleSearch)) {
+                epochEdges.add(from, to);
+                cycle = transactionGraph.hasCycleThrough(from, FraudDetectionSystem::MAX_CYCLE_LENGTH, shard.cycleSearch,
+                                                         epochEdges);
+                epochEdges.removeLast();
+                searchesRerun.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (cycle) {
+                isFraudulent = true;
+                fraudReason = CIRCULAR_TRANSACTIONS_REASON;
+            } else {
+                epochEdges.add(from, to);
+            }
+
+            if (isFraudulent) {
+                shard.flaggedAccounts.insert(tx.senderAccountID);
+                result = { TransactionStatus::Fraud, fraudReason };
+            } else {
+                *senderBalance -= tx.amount;
+                shard.velocityTracker.record(tx.senderAccountID, tx.timestamp);
+                shard.edgeStats.record(tx.senderAccountID, tx.receiverAccountID, tx.amount, tx.timestamp);
+                if (receiverLocal) {
+                    *receiverBalance += tx.amount;
+                    shard.velocityTracker.record(tx.receiverAccountID, tx.timestamp);
+                }
+            }
+        }
+
+        if ((index + 1) % EPOCH_SIZE == 0 || index + 1 == batch->size()) {
+            waitForGraphTurn(index);
+            finishEpoch(index);
+        }
+        slot.graphDone.store(1, std::memory_order_release);
+        if (!receiverLocal) {
+            bool accepted = result.status == TransactionStatus::Accepted;
+            slot.decision.store(accepted ? DECISION_ACCEPTED : DECISION_REJECTED, std::memory_order_release);
+        }
+        results[index] = std::move(result);
+    }
+
+    void runShard(size_t shardIndex) {
+        Shard& shard = *shards[shardIndex];
+        for (uint32_t index : shard.work) {
+            const TransactionView& tx = (*batch)[index];
+            size_t senderShard = shardOf(tx.senderAccountID);
+            if (senderShard == shardIndex) {
+                decide(shard, index, tx, shardOf(tx.receiverAccountID) == shardIndex);
+            } else {
+                serveReceiver(shard, index, tx);
+            }
+        }
+    }
+
+public:
+    // The dictionaries are shared, not copied, and must not change while a batch runs
+    ShardedFraudEngine(const BKTree& bkTree, const PatternAutomaton& patternAutomaton, size_t numShards,
+                       size_t expectedFlaggedAccounts = 100000, double bloomFalsePositiveRate = 0.01,
+                       long long velocityWindow = 60, int velocityLimit = 5)
+        : descriptionChecker(bkTree, patternAutomaton) {
+        numShards = std::max<size_t>(1, numShards);
+        for (size_t i = 0; i < numShards; ++i) {
+            shards.push_back(std::make_unique<Shard>(expectedFlaggedAccounts / numShards + 1, bloomFalsePositiveRate,
+                                                     velocityWindow, velocityLimit));
+        }
+    }
+
+    size_t shardCount() const {
+        return shards.size();
+    }
+
+    // Returns false if the account already exists
+    bool addAccount(int accountID, double initialBalance) {
+        FlatHashMap<double>& balances = shards[shardOf(accountID)]->balances;
+        if (balances.find(accountKey(accountID))) return false;
+        balances[accountKey(accountID)] = initialBalance;
+        return true;
+    }
+
+    bool getBalance(int accountID, double& balance) const {
+        const double* found = shards[shardOf(accountID)]->balances.find(accountKey(accountID));
+        if (!found) return false;
+        balance = *found;
+        return true;
+    }
+
+    std::vector<TransactionResult> processBatch(const std::vector<TransactionView>& transactions) {
+        batch = &transactions;
+        slots.reset(new TransferSlot[transactions.size()]);
+        results.assign(transactions.size(), TransactionResult{ TransactionStatus::Accepted, "" });
+        graphWatermark.store(0);
+        descriptionChecker.validate();
+        prepareEpoch(0);
+        epochsReady.store(1);
+
+        for (auto& shard : shards) shard->work.clear();
+        for (uint32_t i = 0; i < transactions.size(); ++i) {
+            size_t senderShard = shardOf(transactions[i].senderAccountID);
+            size_t receiverShard = shardOf(transactions[i].receiverAccountID);
+            shards[senderShard]->work.push_back(i);
+            if (receiverShard != senderShard) shards[receiverShard]->work.push_back(i);
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < shards.size(); ++i) threads.emplace_back(&ShardedFraudEngine::runShard, this, i);
+        runShard(0);
+        for (auto& thread : threads) thread.join();
+
+        batch = nullptr;
+        slots.reset();
+        return std::move(results);
+    }
+
+    void printCacheStatistics(std::ostream& out = std::cout) const {
+        descriptionChecker.printStatistics(out);
+    }
+
+    void printCycleSearchStatistics(std::ostream& out = std::cout) const {
+        out << "Cycle searches: " << searchesAhead.load() << " run ahead of their turn, " << searchesRerun.load()
+            << " re-run over edges added in their epoch." << std::endl;
+    }
+};
+
+// Function to read words from a file and insert into BKTree
+void loadWordsIntoBKTree(const std::string& filename, BKTree& bkTree) {
+    std::ifstream file(filename);
+    std::string word;
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return;
+    }
+
+    while (file >> word) {
+        // Insert into BK Tree
+        bkTree.insert(word);
+    }
+    file.close();
+    bkTree.compact();
+}
+
+// Function to read words from a file, add them to suspicious patterns and recompile the automaton
+void loadWordsIntoPatternAutomaton(const std::string& filename, PatternAutomaton& patternAutomaton, std::unordered_set<std::string>& suspiciousPatterns) {
+    std::ifstream file(filename);
+    std::string word;
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return;
+    }
+
+    while (file >> word) {
+        // Add suspicious words to the set
+        suspiciousPatterns.insert(word);
+    }
+    file.close();
+    patternAutomaton.build(suspiciousPatterns);
+}
+
+// First occurrence of byte in [p, end), or end. Compares 16 bytes per step with SSE2.
+inline const char* findByte(const char* p, const char* end, char byte) {
+#if defined(__SSE2__)
+    const __m128i target = _mm_set1_epi8(byte);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, target));
+        if (mask) return p + __builtin_ctz(static_cast<unsigned>(mask));
+        p += 16;
+    }
+#endif
+    while (p < end && *p != byte) ++p;
+    return p;
+}
+
+// Parse a whole numeric field (surrounding spaces allowed) without allocating or throwing
+template <typename T>
+bool parseNumberField(std::string_view field, T& value) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+    if (!field.empty() && field.front() == '+') field.remove_prefix(1);
+    const char* end = field.data() + field.size();
+    auto parsed = std::from_chars(field.data(), end, value);
+    return parsed.ec == std::errc() && parsed.ptr == end && !field.empty();
+}
+
+// Parse the numeric value of a command-line option, complaining on stderr if it is not one
+template <typename T>
+bool parseOptionNumber(const std::string& option, std::string_view text, T& value) {
+    if (parseNumberField(text, value)) return true;
+    std::cerr << "Invalid value for " << option << ": '" << text << "'" << std::endl;
+    return false;
+}
+
+// Parse one line: ID,sender,receiver,amount,timestamp,description (the description
+// runs to the end of the line and may contain commas)
+bool parseTransactionLine(std::string_view line, TransactionView& tx, std::string& error) {
+    std::string_view fields[5];
+    const char* p = line.data();
+    const char* end = p + line.size();
+    for (auto& field : fields) {
+        const char* comma = findByte(p, end, ',');
+        if (comma == end) {
+            error = "expected 6 comma-separated fields";
+            return false;
+        }
+        field = std::string_view(p, comma - p);
+        p = comma + 1;
+    }
+
+    tx.transactionID = fields[0];
+    tx.description = std::string_view(p, end - p);
+    if (!parseNumberField(fields[1], tx.senderAccountID)) error = "invalid sender account ID";
+    else if (!parseNumberField(fields[2], tx.receiverAccountID)) error = "invalid receiver account ID";
+    else if (!parseNumberField(fields[3], tx.amount)) error = "invalid amount";
+    else if (!parseNumberField(fields[4], tx.timestamp)) error = "invalid timestamp";
+    else return true;
+    return false;
+}
+
+// Parse every line in [begin, end); line numbers start at firstLine. Malformed
+// lines are recorded in errors and skipped, blank lines are ignored. Returns
+// the number of the line following the range.
+size_t parseTransactionRecords(const char* begin, const char* end, size_t firstLine,
+                             std::vector<TransactionView>& records, std::vector<ParseError>& errors) {
+    std::string error;
+    size_t lineNumber = firstLine;
+    for (const char* p = begin; p < end; ++lineNumber) {
+        const char* newline = findByte(p, end, '\n');
+        std::string_view line(p, newline - p);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        p = newline + 1;
+        if (line.empty()) continue;
+
+        TransactionView tx;
+        if (parseTransactionLine(line, tx, error)) {
+            records.push_back(tx);
+        } else {
+            errors.push_back({ lineNumber, error });
+        }
+    }
+    return lineNumber;
+}
+
+// Binary transaction files, as written by generateRecords --format binary, start
+// with "FDST" and a version byte. Each record follows as: ID length u8, ID bytes,
+// sender i32, receiver i32, amount f64, timestamp i64, description length u8 and
+// description bytes, in the writer's byte order.
+const char BINARY_TRANSACTIONS_HEADER[5] = { 'F', 'D', 'S', 'T', 1 };
+
+bool hasBinaryTransactionsHeader(const char* begin, const char* end) {
+    return static_cast<size_t>(end - begin) >= sizeof(BINARY_TRANSACTIONS_HEADER) &&
+           std::memcmp(begin, BINARY_TRANSACTIONS_HEADER, sizeof(BINARY_TRANSACTIONS_HEADER)) == 0;
+}
+
+// Parse the complete binary records in [begin, end), which follows the header.
+// recordNumber is the 1-based number of the next record and advances past each
+// one parsed. Returns the end of the last complete record; anything after it is
+// a record the range cuts short.
+const char* parseBinaryTransactionRecords(const char* begin, const char* end, size_t& recordNumber,
+                                          std::vector<TransactionView>& records) {
+    const size_t FIXED_BYTES = 4 + 4 + 8 + 8 + 1;  // Fields between the ID and the description
+    const char* p = begin;
+    while (end - p >= 1) {
+        size_t idLength = static_cast<unsigned char>(p[0]);
+        if (static_cast<size_t>(end - p) < 1 + idLength + FIXED_BYTES) break;
+        const char* fields = p + 1 + idLength;
+        size_t descriptionLength = static_cast<unsigned char>(fields[FIXED_BYTES - 1]);
+        if (static_cast<size_t>(end - p) < 1 + idLength + FIXED_BYTES + descriptionLength) break;
+
+        TransactionView tx;
+        int32_t sender, receiver;
+        int64_t timestamp;
+        std::memcpy(&sender, fields, 4);
+        std::memcpy(&receiver, fields + 4, 4);
+        std::memcpy(&tx.amount, fields + 8, 8);
+        std::memcpy(&timestamp, fields + 16, 8);
+        tx.transactionID = std::string_view(p + 1, idLength);
+        tx.senderAccountID = sender;
+        tx.receiverAccountID = receiver;
+        tx.timestamp = timestamp;
+        tx.description = std::string_view(fields + FIXED_BYTES, descriptionLength);
+        records.push_back(tx);
+        ++recordNumber;
+        p = fields + FIXED_BYTES + descriptionLength;
+    }
+    return p;
+}
 
-        for (int i = 0; i <= len1; ++i) d[i][0] = i;
-        for (int j = 0; j <= len2; ++j) d[0][j] = j;
+const size_t MAX_LISTED_PARSE_ERRORS = 10;
 
-        for (int i = 1; i <= len1; ++i) {
-            for (int j = 1; j <= len2; ++j) {
-                int cost = (tolower(s1[i - 1]) == tolower(s2[j - 1])) ? 0 : 1;
-                d[i][j] = std::min({
-                    d[i - 1][j] + 1,       // Deletion
-                    d[i][j - 1] + 1,       // Insertion
-                    d[i - 1][j - 1] + cost // Substitution
-                });
-            }
-        }
-        return d[len1][len2];
+// Report skipped lines on stderr, listing the first few. totalErrors may exceed
+// errors.size() when the caller kept only the first errors. unit names what the
+// error numbers count: lines, or records in a binary file.
+void reportParseErrors(const std::string& filename, const std::vector<ParseError>& errors, size_t totalErrors,
+                       const char* unit = "line") {
+    size_t listed = std::min(errors.size(), MAX_LISTED_PARSE_ERRORS);
+    for (size_t i = 0; i < listed; ++i) {
+        std::cerr << "Skipping malformed " << unit << " " << errors[i].lineNumber << " in " << filename
+                  << ": " << errors[i].message << std::endl;
+    }
+    if (totalErrors > listed) {
+        std::cerr << "... " << totalErrors - listed << " more malformed " << unit << "s skipped in " << filename
+                  << std::endl;
     }
+}
 
-public:
-    BKTree() : root(nullptr) {}
+// A transaction file, text or binary, mapped and parsed in place. The records
+// view the mapping, so they stay valid only while the TransactionFile lives.
+class TransactionFile {
+private:
+    MappedFile file;
+    std::vector<TransactionView> transactions;
 
-    ~BKTree() {
-        // Destructor to clean up nodes
-        if (root) {
-            std::queue<BKTreeNode*> nodes;
-            nodes.push(root);
-            while (!nodes.empty()) {
-                BKTreeNode* current = nodes.front();
-                nodes.pop();
-                for (auto& childPair : current->children) {
-                    nodes.push(childPair.second);
-                }
-                delete current;
+public:
+    explicit TransactionFile(const std::string& filename) : file(filename) {
+        if (!file.isOpen()) {
+            std::cerr << "Error opening file for reading: " << filename << std::endl;
+            return;
+        }
+        std::vector<ParseError> errors;
+        const char* begin = file.contents().data();
+        const char* end = begin + file.contents().size();
+        if (hasBinaryTransactionsHeader(begin, end)) {
+            size_t recordNumber = 1;
+            if (parseBinaryTransactionRecords(begin + sizeof(BINARY_TRANSACTIONS_HEADER), end, recordNumber,
+                                              transactions) != end) {
+                errors.push_back({ recordNumber, "truncated record" });
             }
+            reportParseErrors(filename, errors, errors.size(), "record");
+            return;
         }
+        parseTransactionRecords(begin, end, 1, transactions, errors);
+        reportParseErrors(filename, errors, errors.size());
     }
 
-    void insert(const std::string& word) {
-        if (!root) {
-            root = new BKTreeNode(word);
-            return;
-        }
+    TransactionFile(const TransactionFile&) = delete;
+    TransactionFile& operator=(const TransactionFile&) = delete;
+
+    const std::vector<TransactionView>& records() const {
+        return transactions;
+    }
+};
 
-        BKTreeNode* node = root;
-        int distance = levenshteinDistance(word, node->word);
+// Unbuffered byte source for streaming: a regular file, a named pipe, or
+// standard input when the name is "-". Reads return whatever is available, so
+// a live feed is processed as it arrives rather than a full chunk at a time.
+class ByteSource {
+private:
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = -1;
+    bool ownsDescriptor = false;
+#else
+    std::ifstream file;
+    std::istream* stream = nullptr;
+#endif
 
-        while (node->children.count(distance)) {
-            node = node->children[distance];
-            distance = levenshteinDistance(word, node->word);
+public:
+    explicit ByteSource(const std::string& filename) {
+#if defined(__unix__) || defined(__APPLE__)
+        if (filename == "-") {
+            fd = STDIN_FILENO;
+        } else {
+            fd = ::open(filename.c_str(), O_RDONLY);
+            ownsDescriptor = fd >= 0;
+        }
+#else
+        if (filename == "-") {
+            stream = &std::cin;
+        } else {
+            file.open(filename, std::ios::binary);
+            if (file) stream = &file;
         }
-        node->children[distance] = new BKTreeNode(word);
+#endif
     }
 
-    bool search(const std::string& query, int maxDistance) {
-        if (!root) return false;
-
-        std::queue<BKTreeNode*> nodes;
-        nodes.push(root);
+    ~ByteSource() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (ownsDescriptor) ::close(fd);
+#endif
+    }
 
-        while (!nodes.empty()) {
-            BKTreeNode* node = nodes.front();
-            nodes.pop();
+    ByteSource(const ByteSource&) = delete;
+    ByteSource& operator=(const ByteSource&) = delete;
 
-            int distance = levenshteinDistance(query, node->word);
-            if (distance <= maxDistance && distance > 0) {  // distance > 0 to exclude exact matches
-                return true;
-            }
+    bool isOpen() const {
+#if defined(__unix__) || defined(__APPLE__)
+        return fd >= 0;
+#else
+        return stream != nullptr;
+#endif
+    }
 
-            for (int i = distance - maxDistance; i <= distance + maxDistance; ++i) {
-                if (i >= 0 && node->children.count(i)) {
-                    nodes.push(node->children[i]);
-                }
-            }
+    // Bytes read into out, 0 at end of input
+    size_t read(char* out, size_t size) {
+#if defined(__unix__) || defined(__APPLE__)
+        while (true) {
+            ssize_t count = ::read(fd, out, size);
+            if (count >= 0) return static_cast<size_t>(count);
+            if (errno != EINTR) return 0;
         }
-        return false;
+#else
+        stream->read(out, static_cast<std::streamsize>(size));
+        return static_cast<size_t>(stream->gcount());
+#endif
     }
 };
 
-// Suffix Tree Node
-class SuffixTreeNode {
+// Blocking queue of bounded capacity between producer and consumer threads.
+// push waits while the queue is full; pop waits while it is empty and returns
+// false once the queue is closed and drained.
+template <typename T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+
 public:
-    std::unordered_map<char, SuffixTreeNode*> children;
-    bool isEndOfWord;
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
 
-    SuffixTreeNode() : isEndOfWord(false) {}
-    
-    // Destructor to delete children nodes
-    ~SuffixTreeNode() {
-        for (auto& pair : children) {
-            delete pair.second; // Recursively delete all children
-        }
+    // Returns false, dropping item, if the queue was closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&]() { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
     }
-};
 
-// Suffix Tree for pattern detection
-class SuffixTree {
-private:
-    SuffixTreeNode* root;
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&]() { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
 
-public:
-    SuffixTree() {
-        root = new SuffixTreeNode();
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
     }
+};
+
+// Bytes read from a stream and the transactions parsed in place from them;
+// the records view buffer, so the two travel together.
+struct TransactionChunk {
+    std::vector<char> buffer;
+    std::vector<TransactionView> records;
+};
+
+// Process a transaction file, named pipe or standard input ("-"), text or
+// binary, while it is being read. A reader thread parses fixed-size chunks in place and hands
+// them over a bounded queue, so parsing overlaps detection and memory stays
+// constant however long the input is. Results match loading the whole file
+// and calling processBatch. Returns the number of transactions processed.
+size_t streamTransactions(const std::string& filename, FraudDetectionSystem& fds, bool printResults = true) {
+    const size_t CHUNK_BYTES = 1 << 20;
+    const size_t QUEUE_DEPTH = 4;
 
-    ~SuffixTree() {
-        delete root; // Delete the root and its children
+    ByteSource source(filename);
+    if (!source.isOpen()) {
+        std::cerr << "Error opening file for reading: " << filename << std::endl;
+        return 0;
     }
 
-    void insert(const std::string& text) {
-        for (size_t i = 0; i < text.length(); ++i) {
-            SuffixTreeNode* node = root;
-            for (size_t j = i; j < text.length(); ++j) {
-                char c = tolower(text[j]);
-                if (!node->children.count(c)) {
-                    node->children[c] = new SuffixTreeNode();
+    BoundedQueue<TransactionChunk> queue(QUEUE_DEPTH);
+    std::vector<ParseError> errors;
+    size_t totalErrors = 0;
+    bool binary = false;
+
+    std::thread reader([&]() {
+        TransactionChunk chunk;
+        chunk.buffer.resize(CHUNK_BYTES);
+        size_t pending = 0;  // Bytes of an unfinished line or record carried to the next read
+        size_t lineNumber = 1;  // Of the next line, or record in a binary file
+        bool formatKnown = false;
+        bool endOfInput = false;
+        while (!endOfInput) {
+            // A single line longer than the buffer grows it
+            if (pending == chunk.buffer.size()) chunk.buffer.resize(chunk.buffer.size() * 2);
+            size_t count = source.read(chunk.buffer.data() + pending, chunk.buffer.size() - pending);
+            endOfInput = count == 0;
+            pending += count;
+
+            // The header tells a binary file from text; a pipe may deliver it in pieces
+            if (!formatKnown) {
+                if (pending < sizeof(BINARY_TRANSACTIONS_HEADER) && !endOfInput) continue;
+                formatKnown = true;
+                binary = hasBinaryTransactionsHeader(chunk.buffer.data(), chunk.buffer.data() + pending);
+                if (binary) {
+                    pending -= sizeof(BINARY_TRANSACTIONS_HEADER);
+                    std::memmove(chunk.buffer.data(), chunk.buffer.data() + sizeof(BINARY_TRANSACTIONS_HEADER), pending);
                 }
-                node = node->children[c];
             }
-            node->isEndOfWord = true;
-        }
-    }
 
-    bool search(const std::string& pattern) {
-        SuffixTreeNode* node = root;
-        for (char c : pattern) {
-            c = tolower(c);
-            if (!node->children.count(c)) {
-                return false;
+            // Parse up to the last complete line or record. At the end an unterminated
+            // line is a line too, while a cut-off record is an error.
+            const char* begin = chunk.buffer.data();
+            const char* end = begin + pending;
+            size_t errorsBefore = errors.size();
+            if (binary) {
+                end = parseBinaryTransactionRecords(begin, end, lineNumber, chunk.records);
+                if (endOfInput && end != begin + pending) errors.push_back({ lineNumber, "truncated record" });
+            } else {
+                if (!endOfInput) {
+                    while (end > begin && end[-1] != '\n') --end;
+                }
+                lineNumber = parseTransactionRecords(begin, end, lineNumber, chunk.records, errors);
             }
-            node = node->children[c];
+            totalErrors += errors.size() - errorsBefore;
+            if (errors.size() > MAX_LISTED_PARSE_ERRORS) errors.resize(MAX_LISTED_PARSE_ERRORS);
+            if (end == begin) continue;
+
+            // The queued buffer is handed over whole; the unfinished line starts the next one
+            TransactionChunk next;
+            next.buffer.resize(std::max(CHUNK_BYTES, chunk.buffer.size()));
+            pending -= end - begin;
+            std::memcpy(next.buffer.data(), end, pending);
+            bool empty = chunk.records.empty();
+            std::swap(chunk, next);
+            if (!empty && !queue.push(std::move(next))) break;
         }
-        return node->isEndOfWord; // Check if it's the end of a word
-    }
+        queue.close();
+    });
 
-    // Clear the suffix tree
-    void clear() {
-        delete root; // Delete current root and all children
-        root = new SuffixTreeNode(); // Reinitialize root
+    size_t processed = 0;
+    TransactionChunk chunk;
+    while (queue.pop(chunk)) {
+        fds.processBatch(chunk.records, printResults);
+        processed += chunk.records.size();
     }
-};
+    reader.join();
+    reportParseErrors(filename, errors, totalErrors, binary ? "record" : "line");
+    return processed;
+}
 
-// Bloom Filter for fast flagged account detection
-class BloomFilter {
-    std::bitset<BLOOM_FILTER_SIZE> filter;
+// Original full-matrix Levenshtein distance, kept as the benchmark baseline
+int referenceLevenshteinDistance(const std::string& s1, const std::string& s2) {
+    int len1 = s1.size(), len2 = s2.size();
+    std::vector<std::vector<int>> d(len1 + 1, std::vector<int>(len2 + 1));
 
-    std::hash<int> hashFn;
+    for (int i = 0; i <= len1; ++i) d[i][0] = i;
+    for (int j = 0; j <= len2; ++j) d[0][j] = j;
 
-    int hash(int data, int seed) {
-        return (hashFn(data + seed)) % BLOOM_FILTER_SIZE;
+    for (int i = 1; i <= len1; ++i) {
+        for (int j = 1; j <= len2; ++j) {
+            int cost = (tolower(s1[i - 1]) == tolower(s2[j - 1])) ? 0 : 1;
+            d[i][j] = std::min({
+                d[i - 1][j] + 1,       // Deletion
+                d[i][j - 1] + 1,       // Insertion
+                d[i - 1][j - 1] + cost // Substitution
+            });
+        }
     }
+    return d[len1][len2];
+}
 
-public:
-    void insert(int accountID) {
-        for (int i = 0; i < NUM_HASH_FUNCTIONS; ++i) {
-            int index = hash(accountID, i);
-            filter.set(index);
+// Microbenchmark: reference matrix DP vs. the LevenshteinQuery kernel
+void runLevenshteinBenchmark() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::uniform_int_distribution<int> length(3, 14);
+
+    std::vector<std::string> words(2000);
+    for (auto& w : words) {
+        int len = length(rng);
+        for (int i = 0; i < len; ++i) w.push_back(static_cast<char>(letter(rng)));
+    }
+    // Typo-like queries: copies of dictionary words with a few random edits
+    std::vector<std::string> queries(200);
+    for (auto& q : queries) {
+        q = words[rng() % words.size()];
+        for (int edits = rng() % 3; edits > 0 && !q.empty(); --edits) {
+            q[rng() % q.size()] = static_cast<char>(toupper(letter(rng)));
         }
     }
 
-    bool possiblyExists(int accountID) {
-        for (int i = 0; i < NUM_HASH_FUNCTIONS; ++i) {
-            int index = hash(accountID, i);
-            if (!filter.test(index))
-                return false;
+    auto timeIt = [](const char* name, size_t pairs, const std::function<long long()>& body) {
+        auto start = std::chrono::steady_clock::now();
+        long long checksum = body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << pairs << " pairs in " << seconds * 1000 << " ms ("
+                  << seconds * 1e9 / pairs << " ns/pair, checksum " << checksum << ")" << std::endl;
+        return seconds;
+    };
+
+    const size_t pairs = words.size() * queries.size();
+    double reference = timeIt("reference matrix", pairs, [&]() {
+        long long sum = 0;
+        for (const auto& q : queries)
+            for (const auto& w : words) sum += referenceLevenshteinDistance(q, w);
+        return sum;
+    });
+    double exact = timeIt("bit-parallel exact", pairs, [&]() {
+        long long sum = 0;
+        for (const auto& q : queries) {
+            LevenshteinQuery query(q);
+            for (const auto& w : words) sum += query.distance(w, std::numeric_limits<int>::max());
         }
-        return true;
-    }
-};
+        return sum;
+    });
+    double bounded = timeIt("bit-parallel bound 2", pairs, [&]() {
+        long long sum = 0;
+        for (const auto& q : queries) {
+            LevenshteinQuery query(q);
+            for (const auto& w : words) sum += query.distance(w, 2) <= 2;
+        }
+        return sum;
+    });
 
-// Fraud Detection System
-class FraudDetectionSystem {
-public:
-    BKTree bkTree;
-    SuffixTree suffixTree;
-    BloomFilter bloomFilter;
-    std::unordered_map<int, Account> accounts;
-    std::unordered_map<std::string, Transaction> transactions;
-    std::unordered_set<std::string> suspiciousPatterns;
-    std::unordered_map<int, std::unordered_map<int, int>> transactionCounts; // For frequent transactions
-    std::unordered_map<int, std::unordered_map<int, double>> transactionAmounts;
-    std::unordered_map<int, std::vector<int>> graphAdjacencyList; // For graph representation
+    // Cross-check the kernel, including the banded path for long words
+    size_t mismatches = 0;
+    for (const auto& q : queries) {
+        std::string longQuery = q + std::string(70, 'x');
+        LevenshteinQuery query(q), longQueryKernel(longQuery);
+        for (const auto& w : words) {
+            int expected = referenceLevenshteinDistance(q, w);
+            if (query.distance(w, std::numeric_limits<int>::max()) != expected) ++mismatches;
+            if ((query.distance(w, 2) <= 2) != (expected <= 2)) ++mismatches;
+            std::string longWord = w + std::string(68, 'x');
+            int longExpected = referenceLevenshteinDistance(longQuery, longWord);
+            if (longQueryKernel.distance(longWord, std::numeric_limits<int>::max()) != longExpected) ++mismatches;
+            if ((longQueryKernel.distance(longWord, 3) <= 3) != (longExpected <= 3)) ++mismatches;
+        }
+    }
 
-    FraudDetectionSystem() {}
+    std::cout << "Speedup (exact): " << reference / exact << "x, (bound 2): " << reference / bounded
+              << "x, mismatches: " << mismatches << std::endl;
+}
 
-    ~FraudDetectionSystem() {
-        // Destructor to ensure all dynamically allocated memory is cleaned up
+// Parse a comma-separated list of numbers such as "1000,10000"
+template <typename T>
+bool parseNumberList(const std::string& option, const std::string& text, std::vector<T>& values) {
+    values.clear();
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = text.find(',', begin);
+        if (end == std::string::npos) end = text.size();
+        T value;
+        if (!parseOptionNumber(option, std::string_view(text).substr(begin, end - begin), value)) return false;
+        values.push_back(value);
+        begin = end + 1;
     }
+    return true;
+}
 
-    void addAccount(int accountID, double initialBalance) {
-        if (accounts.find(accountID) != accounts.end()) {
-            std::cout << "Account ID " << accountID << " already exists." << std::endl;
-            return;
+// Per-component microbenchmarks. Every benchmark is run for each combination
+// of the parameters it depends on and prints one JSON line per run, so two
+// runs can be diffed or loaded into a script:
+//   --dictionary N,...          BK-tree words / suspicious patterns
+//   --description-length N,...  characters per description
+//   --accounts N,...            distinct accounts
+//   --density D,...             transfer-graph edges per account
+//   --ops N                     operations timed per repetition
+//   --repeat N                  repetitions; best and median are reported
+//   --seed N                    input generator seed
+//   --only NAME                 run only benchmarks whose name contains NAME
+int runBenchmarkSuite(int argc, char* argv[]) {
+    std::vector<size_t> dictionarySizes = { 1000, 10000 };
+    std::vector<size_t> descriptionLengths = { 16, 64, 256 };
+    std::vector<size_t> accountCounts = { 1000, 100000 };
+    std::vector<double> densities = { 0.5, 2, 8 };
+    size_t ops = 100000, repeat = 3;
+    unsigned seed = 42;
+    std::string only;
+    auto usage = [&]() {
+        std::cerr << "Usage: " << argv[0] << " --bench [--dictionary N,...] [--description-length N,...]"
+                  << " [--accounts N,...] [--density D,...] [--ops N] [--repeat N] [--seed N] [--only NAME]"
+                  << std::endl;
+        return 1;
+    };
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return usage();
         }
-        accounts[accountID] = { accountID, initialBalance, {} };
-        std::cout << "Account ID " << accountID << " added with initial balance $" << initialBalance << "." << std::endl;
+        std::string value = argv[++i];
+        bool valid = true;
+        if (arg == "--dictionary") valid = parseNumberList(arg, value, dictionarySizes);
+        else if (arg == "--description-length") valid = parseNumberList(arg, value, descriptionLengths);
+        else if (arg == "--accounts") valid = parseNumberList(arg, value, accountCounts);
+        else if (arg == "--density") valid = parseNumberList(arg, value, densities);
+        else if (arg == "--ops") valid = parseOptionNumber(arg, value, ops);
+        else if (arg == "--repeat") valid = parseOptionNumber(arg, value, repeat);
+        else if (arg == "--seed") valid = parseOptionNumber(arg, value, seed);
+        else if (arg == "--only") only = value;
+        else {
+            std::cerr << "Unknown benchmark option: " << arg << std::endl;
+            return usage();
+        }
+        if (!valid) return usage();
     }
+    ops = std::max<size_t>(1, ops);
+    repeat = std::max<size_t>(1, repeat);
 
-    void bulkAddAccounts(int startID, int endID, double initialBalance) {
-        for (int i = startID; i <= endID; ++i) {
-            if (accounts.find(i) == accounts.end()) {
-                accounts[i] = { i, initialBalance, {} };
-                std::cout << "Account ID " << i << " added with initial balance $" << initialBalance << "." << std::endl;
+    std::mt19937 rng(seed);
+    auto randomWord = [&](size_t minLength, size_t maxLength) {
+        std::string word(minLength + rng() % (maxLength - minLength + 1), 'a');
+        for (char& c : word) c = static_cast<char>('a' + rng() % 26);
+        return word;
+    };
+    // Roughly a quarter of the queries are one-edit typos of dictionary words
+    auto makeQueries = [&](const std::vector<std::string>& words) {
+        std::vector<std::string> queries(std::min<size_t>(ops, 4096));
+        for (auto& query : queries) {
+            if (rng() % 4 == 0) {
+                query = words[rng() % words.size()];
+                query[rng() % query.size()] = static_cast<char>('a' + rng() % 26);
             } else {
-                std::cout << "Account ID " << i << " already exists. Skipping." << std::endl;
+                query = randomWord(3, 14);
             }
         }
-        std::cout << "Bulk account addition completed." << std::endl;
-    }
+        return queries;
+    };
 
-    void processTransaction(const Transaction& tx) {
-        // Check if sender and receiver exist
-        if (accounts.find(tx.senderAccountID) == accounts.end() ||
-            accounts.find(tx.receiverAccountID) == accounts.end()) {
-            std::cout << "Invalid account involved in transaction ID: " << tx.transactionID << std::endl;
-            return;
+    // Runs setup() then body() `repeat` times and prints the timing line.
+    // body returns a checksum so the work cannot be optimized away.
+    auto run = [&](const std::string& name, const std::string& parameters, size_t count,
+                   const std::function<void()>& setup, const std::function<long long()>& body) {
+        if (!only.empty() && name.find(only) == std::string::npos) return;
+        std::vector<double> nanosPerOp;
+        long long checksum = 0;
+        for (size_t r = 0; r < repeat; ++r) {
+            if (setup) setup();
+            auto start = std::chrono::steady_clock::now();
+            checksum = body();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            nanosPerOp.push_back(seconds * 1e9 / count);
         }
+        std::sort(nanosPerOp.begin(), nanosPerOp.end());
+        std::cout << "{\"benchmark\":\"" << name << "\"" << parameters << ",\"ops\":" << count
+                  << ",\"repeat\":" << repeat << ",\"ns_per_op_best\":" << nanosPerOp.front()
+                  << ",\"ns_per_op_median\":" << nanosPerOp[nanosPerOp.size() / 2]
+                  << ",\"ops_per_second\":" << 1e9 / nanosPerOp.front() << ",\"checksum\":" << checksum << "}" << std::endl;
+    };
 
-        // Check if sender has enough balance
-        if (accounts[tx.senderAccountID].balance < tx.amount) {
-            std::cout << "Insufficient funds for transaction ID: " << tx.transactionID << std::endl;
-            return;
-        }
+    for (size_t dictionarySize : dictionarySizes) {
+        if (dictionarySize == 0) continue;
+        std::vector<std::string> words(dictionarySize);
+        for (auto& word : words) word = randomWord(4, 12);
+        std::string parameters = ",\"dictionary\":" + std::to_string(dictionarySize);
 
-        // Check for flagged accounts
-        if (bloomFilter.possiblyExists(tx.senderAccountID) || bloomFilter.possiblyExists(tx.receiverAccountID)) {
-            std::cout << "Alert: Flagged account involved in transaction ID: " << tx.transactionID
-                      << " (Reason: Flagged Account)" << std::endl;
-            return;  // Transaction fails
+        // BK-tree: building the dictionary, then typo searches at distance 2
+        std::unique_ptr<BKTree> tree;
+        run("bk_insert", parameters, words.size(), [&]() { tree = std::make_unique<BKTree>(); }, [&]() {
+            for (const auto& word : words) tree->insert(word);
+            tree->compact();
+            return static_cast<long long>(tree->version());
+        });
+        BKTree searchTree;
+        for (const auto& word : words) searchTree.insert(word);
+        searchTree.compact();
+        std::vector<std::string> queries = makeQueries(words);
+        run("bk_search", parameters, ops, nullptr, [&]() {
+            long long hits = 0;
+            for (size_t i = 0; i < ops; ++i) hits += searchTree.search(queries[i % queries.size()], 2);
+            return hits;
+        });
+        // The same queries 64 at a time through the shared walk: closest match
+        // only (same checksum as bk_search), then the best 3
+        std::vector<std::string_view> queryViews(queries.begin(), queries.end());
+        BKTree::SearchScratch scratch;
+        std::vector<std::vector<BKTree::Match>> matches;
+        for (size_t k : { 1, 3 }) {
+            run(k == 1 ? "bk_search_batch" : "bk_search_top3", parameters, ops, nullptr, [&]() {
+                long long hits = 0;
+                for (size_t done = 0; done < ops; done += 64) {
+                    size_t first = done % queryViews.size();
+                    size_t count = std::min({ ops - done, queryViews.size() - first, static_cast<size_t>(64) });
+                    searchTree.searchBatch(queryViews.data() + first, count, 2, k, scratch, matches);
+                    for (size_t i = 0; i < count; ++i) hits += k == 1 ? !matches[i].empty() : matches[i].size();
+                }
+                return hits;
+            });
         }
 
-        bool isFraudulent = false;
-        std::string fraudReason;
-
-        // Check for suspicious description using BK Tree (typosquatting)
-        std::istringstream iss(tx.description);
-        std::string word;
-        while (iss >> word) {
-            if (bkTree.search(word, 2)) {  // Levenshtein distance <= 2
-                isFraudulent = true;
-                fraudReason = "Suspicious word detected: '" + word + "'";
-                break;
+        // Pattern automaton (the former suffix tree path): longest suspicious suffix
+        std::unordered_set<std::string> patterns(words.begin(), words.end());
+        PatternAutomaton automaton;
+        automaton.build(patterns);
+        for (size_t length : descriptionLengths) {
+            if (length == 0) continue;
+            std::vector<std::string> descriptions(std::min<size_t>(ops, 4096));
+            for (auto& description : descriptions) {
+                description = randomWord(length, length);
+                // Every eighth description ends with a pattern
+                if (rng() % 8 == 0) {
+                    const std::string& pattern = words[rng() % words.size()];
+                    description.replace(description.size() - std::min(pattern.size(), description.size()),
+                                        std::string::npos, pattern);
+                }
             }
-        }
+            run("pattern_match", parameters + ",\"description_length\":" + std::to_string(length), ops, nullptr, [&]() {
+                long long hits = 0;
+                for (size_t i = 0; i < ops; ++i) hits += automaton.matchSuffix(descriptions[i % descriptions.size()]) != nullptr;
+                return hits;
+            });
 
-        // Check for suspicious patterns using Suffix Tree
-        if (!isFraudulent) {
-            // Insert the transaction description into the suffix tree
-            suffixTree.insert(tx.description);
-            
-            // Check for suspicious patterns
-            for (const auto& pattern : suspiciousPatterns) {
-                if (suffixTree.search(pattern)) {
-                    isFraudulent = true;  // Mark as fraudulent
-                    fraudReason = "Suspicious pattern detected: '" + pattern + "'";
-                    break;  // Exit the loop on first detection
+            // Splitting a mixed-case description into case-folded words: the
+            // stream-and-tolower way, then one folding pass plus string_views
+            std::vector<std::string> sentences(descriptions.size());
+            for (auto& sentence : sentences) {
+                while (sentence.size() < length) {
+                    std::string word = randomWord(2, 10);
+                    word[0] = static_cast<char>(toupper(static_cast<unsigned char>(word[0])));
+                    sentence += (sentence.empty() ? "" : " ") + word;
                 }
             }
-            
-            // Clear the suffix tree after processing the transaction
-            suffixTree.clear();
-        }
-
-        // Velocity Fraud Detection
-        if (!isFraudulent && detectVelocityFraud(tx.senderAccountID, tx.timestamp)) {
-            isFraudulent = true;
-            fraudReason = "Velocity fraud detected";
+            std::string sentenceParameters = parameters + ",\"description_length\":" + std::to_string(length);
+            run("tokenize_stream", sentenceParameters, ops, nullptr, [&]() {
+                long long letters = 0;
+                for (size_t i = 0; i < ops; ++i) {
+                    std::istringstream iss(sentences[i % sentences.size()]);
+                    std::string word;
+                    while (iss >> word) {
+                        for (char& c : word) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+                        letters += word[0];
+                    }
+                }
+                return letters;
+            });
+            std::string folded;
+            run("tokenize_fold", sentenceParameters, ops, nullptr, [&]() {
+                long long letters = 0;
+                for (size_t i = 0; i < ops; ++i) {
+                    const std::string& sentence = sentences[i % sentences.size()];
+                    folded.resize(sentence.size());
+                    foldAsciiCase(sentence.data(), sentence.size(), folded.data());
+                    WordTokenizer words(folded);
+                    std::string_view word;
+                    while (words.next(word)) letters += word[0];
+                }
+                return letters;
+            });
         }
+    }
 
-        // Frequent Transactions to Same Account
-        if (!isFraudulent && detectFrequentTransactions(tx.senderAccountID, tx.receiverAccountID, tx.amount)) {
-            isFraudulent = true;
-            fraudReason = "Frequent large transactions to the same account";
-        }
+    for (size_t accountCount : accountCounts) {
+        if (accountCount == 0) continue;
+        std::string parameters = ",\"accounts\":" + std::to_string(accountCount);
+        std::vector<int> probes(std::min<size_t>(ops, 1 << 16));
+        for (auto& id : probes) id = static_cast<int>(rng() % (accountCount * 2));
 
-        // Circular Transactions Detection
-        // Add the edge to the graph
-        graphAdjacencyList[tx.senderAccountID].push_back(tx.receiverAccountID);
-        if (!isFraudulent && detectCircularTransactions(tx.senderAccountID, tx.receiverAccountID)) {
-            isFraudulent = true;
-            // Remove the sender and receiver from the adjacency list
-            graphAdjacencyList[tx.senderAccountID].pop_back();
-            fraudReason = "Circular transactions detected";
-        }
+        // Bloom filter: a tenth of the accounts flagged, half the probes outside the range
+        BloomFilter filter(accountCount, 0.01);
+        for (size_t id = 0; id < accountCount; id += 10) filter.insert(static_cast<int>(id));
+        run("bloom_probe", parameters, ops, nullptr, [&]() {
+            long long hits = 0;
+            for (size_t i = 0; i < ops; ++i) hits += filter.possiblyExists(probes[i % probes.size()]);
+            return hits;
+        });
+        std::unique_ptr<bool[]> answers(new bool[probes.size()]);
+        run("bloom_probe_batch", parameters, ops, nullptr, [&]() {
+            long long hits = 0;
+            for (size_t done = 0; done < ops; done += probes.size()) {
+                size_t count = std::min(probes.size(), ops - done);
+                filter.possiblyExistsBatch(probes.data(), count, answers.get());
+                hits += std::count(answers.get(), answers.get() + count, true);
+            }
+            return hits;
+        });
 
-        if (isFraudulent) {
-            // Flag the account
-            bloomFilter.insert(tx.senderAccountID);
-            std::cout << "Alert: Transaction ID " << tx.transactionID << " failed. Reason: " << fraudReason << std::endl;
-            std::cout << "Account ID " << tx.senderAccountID << " has been flagged." << std::endl;
-            return;  // Transaction fails
-        }
+        // Velocity check plus the record that follows an accepted transaction;
+        // every other operation goes to one of 16 busy accounts
+        std::unique_ptr<FraudDetectionSystem> fds;
+        run("velocity", parameters, ops, [&]() {
+            fds = std::make_unique<FraudDetectionSystem>(1024, 0.01, 0);
+            fds->bulkAddAccounts(0, static_cast<int>(accountCount * 2 - 1), 0.0, false);
+        }, [&]() {
+            long long hits = 0;
+            for (size_t i = 0; i < ops; ++i) {
+                int id = i % 2 ? probes[i % 16] : probes[i % probes.size()];
+                long long now = static_cast<long long>(i / 4);
+                uint32_t slot = fds->accounts.find(id);
+                hits += fds->velocityTracker.exceedsSlot(slot, now);
+                fds->velocityTracker.recordSlot(slot, now);
+            }
+            return hits;
+        });
 
-        // Process the transaction
-        accounts[tx.senderAccountID].balance -= tx.amount;
-        accounts[tx.receiverAccountID].balance += tx.amount;
+        for (double density : densities) {
+            if (density <= 0) continue;
+            std::ostringstream densityText;
+            densityText << density;
+            std::string graphParameters = parameters + ",\"density\":" + densityText.str();
+            size_t edgeCount = static_cast<size_t>(accountCount * density);
+            std::vector<std::pair<int, int>> edges(edgeCount);
+            for (auto& edge : edges) {
+                edge.first = static_cast<int>(rng() % accountCount);
+                edge.second = static_cast<int>(rng() % accountCount);
+            }
+            FraudDetectionSystem graphSystem(0);
+            // Pairs repeat 1 to 4 times, so some are at the frequency limit
+            for (size_t i = 0; i < edges.size(); ++i) {
+                for (size_t repeats = i % 4 + 1; repeats > 0; --repeats) {
+                    graphSystem.edgeStats.record(edges[i].first, edges[i].second, 20000.0, static_cast<long long>(i));
+                }
+                graphSystem.transactionGraph.addEdge(edges[i].first, edges[i].second);
+            }
 
-        // Add transaction to histories
-        accounts[tx.senderAccountID].transactionHistory.push_back(tx);
-        accounts[tx.receiverAccountID].transactionHistory.push_back(tx);
-        transactions[tx.transactionID] = tx;
+            // Repeated large transfers along existing and new pairs
+            run("frequent_transactions", graphParameters, ops, nullptr, [&]() {
+                long long hits = 0;
+                for (size_t i = 0; i < ops; ++i) {
+                    const auto& edge = edges[(i * 7919) % edges.size()];
+                    int receiver = i % 2 ? edge.second : probes[i % probes.size()];
+                    hits += graphSystem.detectFrequentTransactions(edge.first, receiver, 20000.0);
+                }
+                return hits;
+            });
+            run("circular_transactions", graphParameters, ops, nullptr, [&]() {
+                long long hits = 0;
+                for (size_t i = 0; i < ops; ++i) {
+                    const auto& edge = edges[(i * 7919) % edges.size()];
+                    hits += graphSystem.detectCircularTransactions(edge.first, edge.second);
+                }
+                return hits;
+            });
+        }
+    }
+    return 0;
+}
 
-        // Update transaction counts and amounts
-        transactionCounts[tx.senderAccountID][tx.receiverAccountID]++;
-        transactionAmounts[tx.senderAccountID][tx.receiverAccountID] += tx.amount;
+// Runs one transaction file through the sequential and the sharded engine and
+// checks that both reach the same decisions and final balances
+int runShardedComparison(int argc, char* argv[]) {
+    size_t numShards = 0;
+    int firstAccount = 0, lastAccount = 0;
+    double initialBalance = 0;
+    if (argc != 9 || !parseOptionNumber("<shards>", argv[2], numShards) || numShards == 0 ||
+        !parseOptionNumber("<first account>", argv[5], firstAccount) ||
+        !parseOptionNumber("<last account>", argv[6], lastAccount) ||
+        !parseOptionNumber("<initial balance>", argv[7], initialBalance)) {
+        std::cerr << "Usage: " << argv[0] << " --sharded-compare <shards> <bk words file> <patterns file>"
+                  << " <first account> <last account> <initial balance> <transactions file>" << std::endl;
+        return 1;
+    }
 
-        // Update graph
-        graphAdjacencyList[tx.senderAccountID].push_back(tx.receiverAccountID);
+    FraudDetectionSystem fds;
+    loadWordsIntoBKTree(argv[3], fds.bkTree);
+    loadWordsIntoPatternAutomaton(argv[4], fds.patternAutomaton, fds.suspiciousPatterns);
+    fds.bulkAddAccounts(firstAccount, lastAccount, initialBalance, false);
+    ShardedFraudEngine engine(fds.bkTree, fds.patternAutomaton, numShards);
+    for (int id = firstAccount; id <= lastAccount; ++id) engine.addAccount(id, initialBalance);
 
-        std::cout << "Transaction ID " << tx.transactionID << " processed successfully." << std::endl;
-    }
+    TransactionFile file(argv[8]);
+    const std::vector<TransactionView>& transactions = file.records();
 
-    // Velocity Fraud Detection
-    bool detectVelocityFraud(int accountID, long long currentTimestamp) {
-        const int TIME_WINDOW = 60;  // 60 seconds
-        const int MAX_TRANSACTIONS = 5;  // Adjusted for larger dataset
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TransactionResult> sequential = fds.processBatch(transactions, false);
+    double sequentialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        auto& history = accounts[accountID].transactionHistory;
-        int transactionCount = 0;
+    start = std::chrono::steady_clock::now();
+    std::vector<TransactionResult> sharded = engine.processBatch(transactions);
+    double shardedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        // Count transactions within the time window
-        for (auto it = history.rbegin(); it != history.rend(); ++it) {
-            if (currentTimestamp - it->timestamp <= TIME_WINDOW) {
-                transactionCount++;
-                if (transactionCount >= MAX_TRANSACTIONS) {
-                    return true;
-                }
-            } else {
-                break;
-            }
-        }
-        return false;
+    size_t mismatches = 0, accepted = 0;
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        if (sequential[i].status != sharded[i].status || sequential[i].reason != sharded[i].reason) ++mismatches;
+        accepted += sequential[i].status == TransactionStatus::Accepted;
+    }
+    for (uint32_t i = 0; i < fds.accounts.size(); ++i) {
+        double balance;
+        if (!engine.getBalance(fds.accounts.id(i), balance) || balance != fds.accounts.balance(i)) ++mismatches;
     }
 
-    // Frequent Transactions to the Same Account
-    bool detectFrequentTransactions(int senderID, int receiverID, double amount) {
-        const int TRANSACTION_THRESHOLD = 3;
-        const double AMOUNT_THRESHOLD = 50000.0;  // Example threshold
+    std::cout << transactions.size() << " transactions, " << accepted << " accepted" << std::endl;
+    std::cout << "Sequential: " << transactions.size() / sequentialSeconds << " tx/s" << std::endl;
+    std::cout << "Sharded (" << engine.shardCount() << " shards): " << transactions.size() / shardedSeconds << " tx/s" << std::endl;
+    engine.printCycleSearchStatistics();
+    std::cout << "Mismatches: " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 2;
+}
 
-        int count = transactionCounts[senderID][receiverID] + 1;
-        double totalAmount = transactionAmounts[senderID][receiverID] + amount;
+#if defined(__unix__) || defined(__APPLE__)
+extern "C" void handleProfileDumpSignal(int) {
+    StageProfiler::instance().requestDump();
+}
+#endif
 
-        if (count >= TRANSACTION_THRESHOLD && totalAmount >= AMOUNT_THRESHOLD) {
-            return true;
-        }
+// Turns on stage profiling for a command-line run. Besides the periodic
+// reports, sending SIGUSR1 prints a dump after the chunk in progress.
+void enableStageProfiling(bool hardwareCounters, double reportSeconds) {
+    StageProfiler& profiler = StageProfiler::instance();
+    profiler.setReportInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(reportSeconds)));
+    profiler.enable(hardwareCounters);
+#if defined(__unix__) || defined(__APPLE__)
+    std::signal(SIGUSR1, handleProfileDumpSignal);
+#endif
+}
+
+// Consumes a retention option at argv[i], if it is one:
+//   --retain-age <seconds>     keep transactions this much older than the newest
+//   --retain-count <n>         keep the newest n accepted transactions
+//   --memory-budget <MiB>      keep as many as fit in this much memory
+//   --archive <file>           append evicted transactions to file
+// valid is cleared, with a message on stderr, when the option's value is
+// missing or malformed.
+bool parseRetentionOption(int argc, char* argv[], int& i, RetentionPolicy& policy, bool& valid) {
+    std::string arg = argv[i];
+    if (arg != "--retain-age" && arg != "--retain-count" && arg != "--memory-budget" && arg != "--archive") {
         return false;
     }
-
-    // Circular Transactions Detection
-    bool detectCircularTransactions(int senderID, int receiverID) {
-        std::unordered_set<int> visited;
-        return isCyclic(senderID, senderID, visited, 0);
+    if (i + 1 >= argc) {
+        std::cerr << "Missing value for " << arg << std::endl;
+        valid = false;
+        return true;
+    }
+    const char* value = argv[++i];
+    if (arg == "--retain-age") {
+        if (!parseOptionNumber(arg, value, policy.maxAge)) valid = false;
+    } else if (arg == "--retain-count") {
+        if (!parseOptionNumber(arg, value, policy.maxTransactions)) valid = false;
+    } else if (arg == "--memory-budget") {
+        double mebibytes;
+        if (parseNumberField(value, mebibytes) && mebibytes >= 0 && mebibytes < 1e12) {
+            policy.memoryBudget = static_cast<size_t>(mebibytes * (1 << 20));
+        } else {
+            std::cerr << "Invalid value for " << arg << ": '" << value << "'" << std::endl;
+            valid = false;
+        }
+    } else {
+        policy.archivePath = value;
     }
+    return true;
+}
 
-    bool isCyclic(int currentID, int targetID, std::unordered_set<int>& visited, int depth) {
-        if (depth > 10) return false;  // Limit depth to prevent deep recursion
-        visited.insert(currentID);
+// Peak resident memory of the process so far, or 0 where unknown
+size_t peakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
 
-        for (int neighbor : graphAdjacencyList[currentID]) {
-            if (neighbor == targetID && depth > 0) {
-                return true;
-            }
-            if (!visited.count(neighbor)) {
-                if (isCyclic(neighbor, targetID, visited, depth + 1)) {
-                    return true;
-                }
-            }
-        }
-        visited.erase(currentID);
-        return false;
+// Recovers the system from the write-ahead log at path, then opens the log to
+// record what follows. flushMilliseconds is the group commit interval, or 0 to
+// commit every batch before its results are reported.
+std::unique_ptr<WriteAheadLog> openWriteAheadLog(FraudDetectionSystem& fds, const std::string& path, long flushMilliseconds,
+                                                 std::ostream& report) {
+    uint64_t validLength = 0;
+    size_t replayed = 0;
+    auto start = std::chrono::steady_clock::now();
+    if (!fds.recoverFromLog(path, validLength, replayed)) return nullptr;
+    if (replayed > 0) {
+        report << "Recovered " << replayed << " logged changes from " << path << " in "
+               << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
     }
+    auto log = std::make_unique<WriteAheadLog>();
+    if (!log->open(path, validLength, std::chrono::milliseconds(flushMilliseconds))) return nullptr;
+    fds.writeAheadLog = log.get();
+    return log;
+}
 
-    // Function to retrieve a transaction by ID
-    Transaction* getTransaction(const std::string& transactionID) {
-        if (transactions.find(transactionID) != transactions.end()) {
-            return &transactions[transactionID];
-        }
-        return nullptr;
+// Runs a transaction feed (a file, named pipe or standard input) through the
+// detector as it arrives. Results go through a ResultSink:
+//   --format text|jsonl|binary  output encoding (default text)
+//   --output <file>             write results to a file instead of stdout
+//   --quiet                     emit only alerts
+//   --profile                   per-stage latency profile (on stderr)
+//   --profile-counters          profile with hardware counters too
+//   --report-interval <seconds> periodic profile reports
+//   --wal <file>                recover from and append to a write-ahead log
+//   --wal-interval <ms>         group commit interval (default 0: every batch)
+//   and the retention options of parseRetentionOption
+int runStreaming(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    std::string format = "text", outputPath, walPath;
+    bool quiet = false, profile = false, profileCounters = false;
+    double reportSeconds = 0;
+    long walInterval = 0;
+    RetentionPolicy retention;
+    int firstAccount = 0, lastAccount = 0;
+    double initialBalance = 0;
+    bool valid = true;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (parseRetentionOption(argc, argv, i, retention, valid)) continue;
+        if (arg == "--format" && i + 1 < argc) format = argv[++i];
+        else if (arg == "--output" && i + 1 < argc) outputPath = argv[++i];
+        else if (arg == "--quiet") quiet = true;
+        else if (arg == "--profile") profile = true;
+        else if (arg == "--profile-counters") profile = profileCounters = true;
+        else if (arg == "--report-interval" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], reportSeconds);
+        else if (arg == "--wal" && i + 1 < argc) walPath = argv[++i];
+        else if (arg == "--wal-interval" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], walInterval);
+        else positional.push_back(arg);
+    }
+    if (valid && positional.size() >= 5) {
+        valid = parseOptionNumber("<first account>", positional[2], firstAccount) &&
+                parseOptionNumber("<last account>", positional[3], lastAccount) &&
+                parseOptionNumber("<initial balance>", positional[4], initialBalance);
+    }
+    if (!valid || (positional.size() != 5 && positional.size() != 6)) {
+        std::cerr << "Usage: " << argv[0] << " --stream <bk words file> <patterns file> <first account>"
+                  << " <last account> <initial balance> [transactions file, default - for stdin]"
+                  << " [--format text|jsonl|binary] [--output file] [--quiet]"
+                  << " [--profile] [--profile-counters] [--report-interval seconds]"
+                  << " [--wal file] [--wal-interval ms] [--retain-age seconds] [--retain-count n]"
+                  << " [--memory-budget MiB] [--archive file]" << std::endl;
+        return 1;
     }
+    std::string input = positional.size() == 6 ? positional[5] : "-";
 
-    // Function to print account balance
-    void printAccountBalance(int accountID) {
-        if (accounts.find(accountID) != accounts.end()) {
-            std::cout << "Account ID: " << accountID << ", Balance: $" << accounts[accountID].balance << std::endl;
-        } else {
-            std::cout << "Account ID: " << accountID << " does not exist." << std::endl;
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath, std::ios::binary);
+        if (!outputFile) {
+            std::cerr << "Error opening file for writing: " << outputPath << std::endl;
+            return 1;
         }
     }
+    std::ostream& output = outputPath.empty() ? std::cout : outputFile;
+    // Keep the summary out of machine-readable output on stdout
+    std::ostream& summary = outputPath.empty() && format != "text" ? std::cerr : std::cout;
+    std::unique_ptr<ResultSink> sink = makeResultSink(format, output, quiet);
+    if (!sink) {
+        std::cerr << "Unknown output format: " << format << std::endl;
+        return 1;
+    }
 
-    // Function to load suspicious patterns
-    void addSuspiciousPattern(const std::string& pattern) {
-        suspiciousPatterns.insert(pattern);
+    FraudDetectionSystem fds;
+    fds.resultSink = sink.get();
+    loadWordsIntoBKTree(positional[0], fds.bkTree);
+    loadWordsIntoPatternAutomaton(positional[1], fds.patternAutomaton, fds.suspiciousPatterns);
+    fds.bulkAddAccounts(firstAccount, lastAccount, initialBalance, false);
+    if (!fds.setRetentionPolicy(retention)) return 1;
+    std::unique_ptr<WriteAheadLog> wal;
+    if (!walPath.empty()) {
+        wal = openWriteAheadLog(fds, walPath, walInterval, summary);
+        if (!wal) return 1;
     }
 
-    // Function to display all accounts
-    void displayAllAccounts() {
-        if (accounts.empty()) {
-            std::cout << "No accounts available." << std::endl;
-            return;
-        }
-        std::cout << "List of Accounts:" << std::endl;
-        for (const auto& pair : accounts) {
-            std::cout << "Account ID: " << pair.second.accountID << ", Balance: $" << pair.second.balance << std::endl;
+    if (profile) enableStageProfiling(profileCounters, reportSeconds);
+
+    size_t processed = streamTransactions(input, fds);
+    if (wal) wal->close();
+    sink->drain();
+    summary << processed << " transactions processed from " << (input == "-" ? "standard input" : input) << "." << std::endl;
+    fds.printCacheStatistics(summary);
+    fds.checks.printReport(summary);
+    fds.printRetentionStatistics(summary);
+    summary << "Peak resident memory: " << peakResidentBytes() / (1 << 20) << " MiB" << std::endl;
+    if (profile) StageProfiler::instance().dump(std::cerr);
+    return 0;
+}
+
+// Non-interactive performance harness: loads dictionaries, accounts and
+// transaction files from the command line, replays the files and reports
+// throughput and latency. With --rate R each file is replayed at R times the
+// speed its timestamps imply (0, the default, replays as fast as possible).
+// Transactions that are due are processed together in batches of up to
+// --batch; a transaction's latency runs from when it is due (or, when
+// replaying flat out, from when its batch is submitted) to when its result is
+// committed. Results are only written when --format or --output is given.
+// --profile adds the per-stage profile to the report (--profile-counters with
+// hardware counters, --report-interval for periodic reports on stderr).
+// --snapshot-in starts from a saved snapshot (dictionaries and accounts given
+// as well are added to it); --snapshot-out saves one after the last file.
+// --wal recovers from a write-ahead log on top of that and logs the replay to
+// it, committing every --wal-interval milliseconds (default 0: every batch).
+// --fixed-order runs the fraud checks in their canonical order throughout.
+// The retention options of parseRetentionOption bound the history kept.
+// --shards N replays through ShardedFraudEngine with N shards instead. That
+// engine keeps no snapshot, log, retained history or stage profile, so those
+// options are rejected with it.
+int runReplay(int argc, char* argv[]) {
+    std::string bkFile, patternsFile, format, outputPath, snapshotIn, snapshotOut, walPath;
+    long walInterval = 0;
+    int firstAccount = 0, lastAccount = -1;
+    double initialBalance = 0, rate = 0;
+    size_t batchSize = 1024, numShards = 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    bool quiet = false, profile = false, profileCounters = false, fixedOrder = false;
+    double reportSeconds = 0;
+    std::vector<std::string> files;
+    RetentionPolicy retention;
+    bool valid = true;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (parseRetentionOption(argc, argv, i, retention, valid)) continue;
+        if (arg == "--bk" && i + 1 < argc) bkFile = argv[++i];
+        else if (arg == "--patterns" && i + 1 < argc) patternsFile = argv[++i];
+        else if (arg == "--accounts" && i + 3 < argc) {
+            valid &= parseOptionNumber(arg, argv[++i], firstAccount);
+            valid &= parseOptionNumber(arg, argv[++i], lastAccount);
+            valid &= parseOptionNumber(arg, argv[++i], initialBalance);
         }
+        else if (arg == "--rate" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], rate);
+        else if (arg == "--batch" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], batchSize);
+        else if (arg == "--threads" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], threads);
+        else if (arg == "--format" && i + 1 < argc) format = argv[++i];
+        else if (arg == "--output" && i + 1 < argc) outputPath = argv[++i];
+        else if (arg == "--quiet") quiet = true;
+        else if (arg == "--profile") profile = true;
+        else if (arg == "--profile-counters") profile = profileCounters = true;
+        else if (arg == "--report-interval" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], reportSeconds);
+        else if (arg == "--snapshot-in" && i + 1 < argc) snapshotIn = argv[++i];
+        else if (arg == "--snapshot-out" && i + 1 < argc) snapshotOut = argv[++i];
+        else if (arg == "--wal" && i + 1 < argc) walPath = argv[++i];
+        else if (arg == "--wal-interval" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], walInterval);
+        else if (arg == "--fixed-order") fixedOrder = true;
+        else if (arg == "--shards" && i + 1 < argc) valid &= parseOptionNumber(arg, argv[++i], numShards);
+        else files.push_back(arg);
+    }
+    batchSize = std::max<size_t>(1, batchSize);
+    if (numShards > 0 && (!snapshotIn.empty() || !snapshotOut.empty() || !walPath.empty() || retention.enabled() ||
+                          !retention.archivePath.empty() || profile)) {
+        std::cerr << "--shards cannot be combined with --snapshot-in, --snapshot-out, --wal, retention options"
+                  << " or --profile." << std::endl;
+        valid = false;
+    }
+    if (!valid || (files.empty() && snapshotOut.empty()) || !(rate >= 0)) {
+        std::cerr << "Usage: " << argv[0] << " --replay [--bk file] [--patterns file]"
+                  << " [--accounts <first> <last> <balance>] [--rate multiplier] [--batch size]"
+                  << " [--threads helpers] [--format text|jsonl|binary] [--output file] [--quiet]"
+                  << " [--profile] [--profile-counters] [--report-interval seconds]"
+                  << " [--snapshot-in file] [--snapshot-out file] [--wal file] [--wal-interval ms]"
+                  << " [--fixed-order] [--retain-age seconds] [--retain-count n] [--memory-budget MiB]"
+                  << " [--archive file] [--shards n] <transactions file>..." << std::endl;
+        return 1;
     }
 
-    // Function to display all transactions
-    void displayAllTransactions() {
-        if (transactions.empty()) {
-            std::cout << "No transactions available." << std::endl;
-            return;
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath, std::ios::binary);
+        if (!outputFile) {
+            std::cerr << "Error opening file for writing: " << outputPath << std::endl;
+            return 1;
         }
-        std::cout << "List of Transactions:" << std::endl;
-        for (const auto& pair : transactions) {
-            const Transaction& tx = pair.second;
-            std::cout << "Transaction ID: " << tx.transactionID
-                      << ", Sender: " << tx.senderAccountID
-                      << ", Receiver: " << tx.receiverAccountID
-                      << ", Amount: $" << tx.amount
-                      << ", Timestamp: " << tx.timestamp
-                      << ", Description: " << tx.description << std::endl;
+    }
+    std::unique_ptr<ResultSink> sink;
+    if (!format.empty() || !outputPath.empty()) {
+        if (format.empty()) format = "text";
+        sink = makeResultSink(format, outputPath.empty() ? std::cout : outputFile, quiet);
+        if (!sink) {
+            std::cerr << "Unknown output format: " << format << std::endl;
+            return 1;
         }
     }
-};
+    std::ostream& report = sink && outputPath.empty() ? std::cerr : std::cout;
 
-// Function to read words from a file and insert into BKTree
-void loadWordsIntoBKTree(const std::string& filename, BKTree& bkTree) {
-    std::ifstream file(filename);
-    std::string word;
-    if (!file) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return;
+    using Clock = std::chrono::steady_clock;
+    FraudDetectionSystem fds(100000, 0.01, threads);
+    fds.resultSink = sink.get();
+    if (fixedOrder) fds.checks.setAdaptive(false);
+    if (!snapshotIn.empty()) {
+        auto loadStart = Clock::now();
+        if (!fds.loadSnapshot(snapshotIn)) return 1;
+        report << "Loaded snapshot " << snapshotIn << " (" << fds.transactionsApplied << " transactions applied) in "
+               << std::chrono::duration<double>(Clock::now() - loadStart).count() << " s" << std::endl;
     }
-
-    while (file >> word) {
-        // Insert into BK Tree
-        bkTree.insert(word);
+    if (!bkFile.empty()) loadWordsIntoBKTree(bkFile, fds.bkTree);
+    if (!patternsFile.empty()) loadWordsIntoPatternAutomaton(patternsFile, fds.patternAutomaton, fds.suspiciousPatterns);
+    if (firstAccount <= lastAccount) fds.bulkAddAccounts(firstAccount, lastAccount, initialBalance, false);
+    if (!fds.setRetentionPolicy(retention)) return 1;
+    std::unique_ptr<WriteAheadLog> wal;
+    if (!walPath.empty()) {
+        wal = openWriteAheadLog(fds, walPath, walInterval, report);
+        if (!wal) return 1;
     }
-    file.close();
-}
-
-// Function to read words from a file and add to suspicious patterns
-void loadWordsIntoSuffixTree(const std::string& filename, SuffixTree& suffixTree, std::unordered_set<std::string>& suspiciousPatterns) {
-    std::ifstream file(filename);
-    std::string word;
-    if (!file) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return;
+    // The sharded engine shares the dictionaries loaded into fds
+    std::unique_ptr<ShardedFraudEngine> engine;
+    if (numShards > 0) {
+        engine = std::make_unique<ShardedFraudEngine>(fds.bkTree, fds.patternAutomaton, numShards);
+        for (int id = firstAccount; id <= lastAccount; ++id) engine->addAccount(id, initialBalance);
     }
 
-    while (file >> word) {
-        // Add suspicious words to the set
-        suspiciousPatterns.insert(word);
-    }
-    file.close();
-}
+    if (profile) enableStageProfiling(profileCounters, reportSeconds);
 
-// Function to load transactions from a file
-std::vector<Transaction> loadTransactionsFromFile(const std::string& filename) {
-    std::vector<Transaction> transactions;
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return transactions;
-    }
+    LatencyHistogram latency;
+    size_t statusCounts[5] = {};
+    size_t replayed = 0;
+    double busySeconds = 0, wallSeconds = 0;
+    std::vector<TransactionView> batch;
+    std::vector<Clock::time_point> dueTimes;
 
-    std::string line;
-    while (std::getline(infile, line)) {
-        std::istringstream iss(line);
-        Transaction tx;
-        std::string transactionID;
-        std::string sender, receiver, amount, timestamp, description;
+    for (const std::string& file : files) {
+        // Loading stays outside the measured replay; the batches view the mapped file
+        TransactionFile input(file);
+        const std::vector<TransactionView>& transactions = input.records();
+        if (transactions.empty()) continue;
 
-        // Parse the line
-        if (std::getline(iss, transactionID, ',') &&
-            std::getline(iss, sender, ',') &&
-            std::getline(iss, receiver, ',') &&
-            std::getline(iss, amount, ',') &&
-            std::getline(iss, timestamp, ',') &&
-            std::getline(iss, description)) {
-                
-            tx.transactionID = transactionID;
-            tx.senderAccountID = std::stoi(sender);
-            tx.receiverAccountID = std::stoi(receiver);
-            tx.amount = std::stod(amount);
-            tx.timestamp = std::stoll(timestamp);
-            tx.description = description;
+        auto fileStart = Clock::now();
+        long long firstTimestamp = transactions.front().timestamp;
+        Clock::time_point lastDue = fileStart;
+        size_t next = 0;
+        while (next < transactions.size()) {
+            batch.clear();
+            dueTimes.clear();
+            auto now = Clock::now();
+            while (next < transactions.size() && batch.size() < batchSize) {
+                Clock::time_point due = now;
+                if (rate > 0) {
+                    double offset = static_cast<double>(transactions[next].timestamp - firstTimestamp) / rate;
+                    due = std::max(lastDue, fileStart + std::chrono::duration_cast<Clock::duration>(
+                                                            std::chrono::duration<double>(offset)));
+                    if (due > now) {
+                        if (!batch.empty()) break;
+                        std::this_thread::sleep_until(due);
+                        now = Clock::now();
+                    }
+                    lastDue = due;
+                }
+                batch.push_back(transactions[next++]);
+                dueTimes.push_back(due);
+            }
 
-            transactions.push_back(tx);
+            auto batchStart = Clock::now();
+            std::vector<TransactionResult> results;
+            if (engine) {
+                results = engine->processBatch(batch);
+                if (sink) {
+                    for (size_t i = 0; i < batch.size(); ++i) sink->publish(batch[i], results[i]);
+                }
+            } else {
+                results = fds.processBatch(batch, sink != nullptr);
+            }
+            auto batchEnd = Clock::now();
+            busySeconds += std::chrono::duration<double>(batchEnd - batchStart).count();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                auto arrival = rate > 0 ? dueTimes[i] : batchStart;
+                latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(batchEnd - arrival).count()));
+                ++statusCounts[static_cast<int>(results[i].status)];
+            }
+            replayed += batch.size();
         }
+        if (sink) sink->drain();
+        wallSeconds += std::chrono::duration<double>(Clock::now() - fileStart).count();
+    }
+    if (wal) {
+        wal->close();
+        report << "Write-ahead log: " << wal->groupsCommitted() << " group commits" << std::endl;
+        if (!wal->healthy()) return 1;
+    }
+
+    report << "Replayed " << replayed << " transactions from " << files.size() << " file(s) in "
+           << wallSeconds << " s (" << busySeconds << " s processing)" << std::endl;
+    report << "Throughput: " << (wallSeconds > 0 ? replayed / wallSeconds : 0) << " tx/s wall, "
+           << (busySeconds > 0 ? replayed / busySeconds : 0) << " tx/s processing" << std::endl;
+    report << "Outcomes:";
+    for (int status = 0; status < 5; ++status) {
+        report << " " << transactionStatusName(static_cast<TransactionStatus>(status)) << "=" << statusCounts[status];
+    }
+    report << std::endl;
+    report << "Latency (us): p50 " << latency.percentile(0.50) / 1e3 << ", p99 " << latency.percentile(0.99) / 1e3
+           << ", p999 " << latency.percentile(0.999) / 1e3 << ", max " << latency.max() / 1e3
+           << ", mean " << latency.mean() / 1e3 << std::endl;
+    latency.forEachOctave([&](uint64_t upperBound, uint64_t count) {
+        report << "  <= " << upperBound / 1e3 << " us: " << count << std::endl;
+    });
+    if (engine) {
+        report << "Shards: " << engine->shardCount() << std::endl;
+        engine->printCacheStatistics(report);
+        engine->printCycleSearchStatistics(report);
+    } else {
+        fds.printCacheStatistics(report);
+        fds.checks.printReport(report);
+        fds.printRetentionStatistics(report);
     }
+    report << "Peak resident memory: " << peakResidentBytes() / (1 << 20) << " MiB" << std::endl;
+    if (profile) StageProfiler::instance().dump(report);
 
-    infile.close();
-    return transactions;
+    if (!snapshotOut.empty()) {
+        auto saveStart = Clock::now();
+        fds.saveSnapshot(snapshotOut);
+        double serializeSeconds = std::chrono::duration<double>(Clock::now() - saveStart).count();
+        if (!fds.waitForSnapshot()) return 1;
+        report << "Saved snapshot " << snapshotOut << " (" << fds.transactionsApplied << " transactions applied) in "
+               << std::chrono::duration<double>(Clock::now() - saveStart).count() << " s (" << serializeSeconds
+               << " s before processing could resume)" << std::endl;
+    }
+    return 0;
 }
 
 // Function to display the menu
@@ -560,8 +5867,27 @@ void displayMenu() {
     std::cout << "Please select an option (1-9): ";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench-levenshtein") {
+        runLevenshteinBenchmark();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarkSuite(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--sharded-compare") {
+        return runShardedComparison(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--replay") {
+        return runReplay(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--stream") {
+        return runStreaming(argc, argv);
+    }
+
     FraudDetectionSystem fds;
+    ResultSink consoleSink(std::make_unique<TextResultEncoder>(), std::cout);
+    fds.resultSink = &consoleSink;
     bool exitProgram = false;
 
     while (!exitProgram) {
@@ -587,7 +5913,7 @@ int main() {
                 std::string filename;
                 std::cout << "Enter the filename for Suffix Tree suspicious patterns (e.g., suffix_tree_words.txt): ";
                 std::getline(std::cin, filename);
-                loadWordsIntoSuffixTree(filename, fds.suffixTree, fds.suspiciousPatterns);
+                loadWordsIntoPatternAutomaton(filename, fds.patternAutomaton, fds.suspiciousPatterns);
                 std::cout << "Suffix Tree suspicious patterns loaded successfully from " << filename << "." << std::endl;
                 break;
             }
@@ -626,12 +5952,11 @@ int main() {
                 std::string filename;
                 std::cout << "Enter the filename for initial transactions (e.g., initial_transactions.txt): ";
                 std::getline(std::cin, filename);
-                std::vector<Transaction> transactions = loadTransactionsFromFile(filename);
-                if (!transactions.empty()) {
-                    for (const auto& tx : transactions) {
-                        fds.processTransaction(tx);
-                    }
+                size_t processed = streamTransactions(filename, fds);
+                consoleSink.drain();
+                if (processed > 0) {
                     std::cout << "Transactions loaded and processed successfully from " << filename << "." << std::endl;
+                    fds.printCacheStatistics();
                 } else {
                     std::cout << "No transactions to process from " << filename << "." << std::endl;
                 }
@@ -642,12 +5967,11 @@ int main() {
                 std::string filename;
                 std::cout << "Enter the filename for transactions to process (e.g., new_transactions.txt): ";
                 std::getline(std::cin, filename);
-                std::vector<Transaction> transactions = loadTransactionsFromFile(filename);
-                if (!transactions.empty()) {
-                    for (const auto& tx : transactions) {
-                        fds.processTransaction(tx);
-                    }
+                size_t processed = streamTransactions(filename, fds);
+                consoleSink.drain();
+                if (processed > 0) {
                     std::cout << "Transactions processed successfully from " << filename << "." << std::endl;
+                    fds.printCacheStatistics();
                 } else {
                     std::cout << "No transactions to process from " << filename << "." << std::endl;
                 }